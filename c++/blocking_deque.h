@@ -0,0 +1,262 @@
+#pragma once
+#include "deque.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+// Bounded queue for any number of producer and consumer threads, a Deque
+// under a mutex. Producers wait while capacity elements are queued and
+// consumers wait while none are. push_batch and drain move as many
+// elements as there is room for or as are queued under a single lock,
+// a bucket span at a time, and wake the other side once per batch.
+// Waiters are counted, so nobody is notified when nobody waits.
+// After close() pushes fail and pops take what is left, then fail too.
+template<typename T, size_t BacketSize = DefaultDequeBacketSize<T>()>
+class BlockingDeque {
+ public:
+  explicit BlockingDeque(size_t capacity);
+  BlockingDeque(const BlockingDeque&) = delete;
+  BlockingDeque& operator=(const BlockingDeque&) = delete;
+
+  // wait for room, false if the queue is closed
+  bool push(const T& value);
+  bool push(T&& value);
+  // false if there was no room within timeout, value is kept then
+  template<typename Rep, typename Period>
+  bool push_for(const T& value,
+                const std::chrono::duration<Rep, Period>& timeout);
+  template<typename Rep, typename Period>
+  bool push_for(T&& value, const std::chrono::duration<Rep, Period>& timeout);
+  // Pushes [first, last) in order, waiting for room as often as needed.
+  // Returns how many were pushed, fewer only if the queue got closed.
+  template<typename ForwardIterator>
+  size_t push_batch(ForwardIterator first, ForwardIterator last);
+
+  // wait for an element, false if the queue is closed and empty
+  bool pop(T& value);
+  template<typename Rep, typename Period>
+  bool pop_for(T& value, const std::chrono::duration<Rep, Period>& timeout);
+  // Waits for an element, then moves up to max_count of the front ones to
+  // out. Returns how many, 0 only if the queue is closed and empty or
+  // max_count is 0, which returns at once.
+  template<typename OutputIterator>
+  size_t drain(OutputIterator out, size_t max_count);
+
+  // wakes every waiter, what is queued can still be popped
+  void close();
+
+  size_t size() const;
+  size_t capacity() const { return capacity_; }
+
+ private:
+  using Items = Deque<T, std::allocator<T>, BacketSize>;
+
+  bool Full() const { return items_.size() >= capacity_; }
+  void WakeProducers(std::unique_lock<std::mutex>& lock, size_t freed);
+  void WakeConsumers(std::unique_lock<std::mutex>& lock, size_t added);
+
+  const size_t capacity_;
+  mutable std::mutex mutex_;
+  std::condition_variable not_full_;
+  std::condition_variable not_empty_;
+  Items items_;                       // under mutex_
+  size_t waiting_producers_ = 0;      // under mutex_
+  size_t waiting_consumers_ = 0;      // under mutex_
+  bool closed_ = false;               // under mutex_
+};
+
+template<typename T, size_t BacketSize>
+BlockingDeque<T, BacketSize>::BlockingDeque(size_t capacity):
+  capacity_(capacity)
+{
+  if (capacity == 0) {
+    throw std::invalid_argument("capacity has to be positive");
+  }
+}
+
+// Called with lock held, notifies after unlocking it so a woken thread
+// doesn't block on the mutex right away.
+template<typename T, size_t BacketSize>
+void BlockingDeque<T, BacketSize>::WakeProducers(
+    std::unique_lock<std::mutex>& lock, size_t freed) {
+  size_t waiting = waiting_producers_;
+  lock.unlock();
+  if (waiting == 0 || freed == 0) {
+    return;
+  }
+  if (freed == 1) {
+    not_full_.notify_one();
+  } else {
+    not_full_.notify_all();
+  }
+}
+
+template<typename T, size_t BacketSize>
+void BlockingDeque<T, BacketSize>::WakeConsumers(
+    std::unique_lock<std::mutex>& lock, size_t added) {
+  size_t waiting = waiting_consumers_;
+  lock.unlock();
+  if (waiting == 0 || added == 0) {
+    return;
+  }
+  if (added == 1) {
+    not_empty_.notify_one();
+  } else {
+    not_empty_.notify_all();
+  }
+}
+
+template<typename T, size_t BacketSize>
+bool BlockingDeque<T, BacketSize>::push(const T& value) {
+  T copy(value);
+  return push(std::move(copy));
+}
+
+template<typename T, size_t BacketSize>
+bool BlockingDeque<T, BacketSize>::push(T&& value) {
+  std::unique_lock lock(mutex_);
+  if (Full() && !closed_) {
+    ++waiting_producers_;
+    not_full_.wait(lock, [this] { return !Full() || closed_; });
+    --waiting_producers_;
+  }
+  if (closed_) {
+    return false;
+  }
+  items_.push_back(std::move(value));
+  WakeConsumers(lock, 1);
+  return true;
+}
+
+template<typename T, size_t BacketSize>
+template<typename Rep, typename Period>
+bool BlockingDeque<T, BacketSize>::push_for(
+    const T& value, const std::chrono::duration<Rep, Period>& timeout) {
+  T copy(value);
+  return push_for(std::move(copy), timeout);
+}
+
+template<typename T, size_t BacketSize>
+template<typename Rep, typename Period>
+bool BlockingDeque<T, BacketSize>::push_for(
+    T&& value, const std::chrono::duration<Rep, Period>& timeout) {
+  std::unique_lock lock(mutex_);
+  if (Full() && !closed_) {
+    ++waiting_producers_;
+    not_full_.wait_for(lock, timeout, [this] { return !Full() || closed_; });
+    --waiting_producers_;
+  }
+  if (closed_ || Full()) {
+    return false;
+  }
+  items_.push_back(std::move(value));
+  WakeConsumers(lock, 1);
+  return true;
+}
+
+template<typename T, size_t BacketSize>
+template<typename ForwardIterator>
+size_t BlockingDeque<T, BacketSize>::push_batch(ForwardIterator first,
+                                                ForwardIterator last) {
+  static_assert(std::is_convertible_v<
+      typename std::iterator_traits<ForwardIterator>::iterator_category,
+      std::forward_iterator_tag>, "batch is counted before it is pushed");
+  size_t left = static_cast<size_t>(std::distance(first, last));
+  size_t pushed = 0;
+  while (left != 0) {
+    std::unique_lock lock(mutex_);
+    if (Full() && !closed_) {
+      ++waiting_producers_;
+      not_full_.wait(lock, [this] { return !Full() || closed_; });
+      --waiting_producers_;
+    }
+    if (closed_) {
+      break;
+    }
+    size_t count = std::min(left, capacity_ - items_.size());
+    ForwardIterator middle =
+        std::next(first, static_cast<std::ptrdiff_t>(count));
+    items_.append(first, middle);
+    first = middle;
+    left -= count;
+    pushed += count;
+    WakeConsumers(lock, count);
+  }
+  return pushed;
+}
+
+template<typename T, size_t BacketSize>
+bool BlockingDeque<T, BacketSize>::pop(T& value) {
+  return drain(&value, 1) == 1;
+}
+
+template<typename T, size_t BacketSize>
+template<typename Rep, typename Period>
+bool BlockingDeque<T, BacketSize>::pop_for(
+    T& value, const std::chrono::duration<Rep, Period>& timeout) {
+  std::unique_lock lock(mutex_);
+  if (items_.size() == 0 && !closed_) {
+    ++waiting_consumers_;
+    not_empty_.wait_for(lock, timeout, [this] {
+      return items_.size() != 0 || closed_;
+    });
+    --waiting_consumers_;
+  }
+  if (items_.size() == 0) {
+    return false;
+  }
+  value = std::move(items_.front());
+  items_.pop_front();
+  WakeProducers(lock, 1);
+  return true;
+}
+
+template<typename T, size_t BacketSize>
+template<typename OutputIterator>
+size_t BlockingDeque<T, BacketSize>::drain(OutputIterator out,
+                                           size_t max_count) {
+  if (max_count == 0) {
+    return 0;
+  }
+  std::unique_lock lock(mutex_);
+  if (items_.size() == 0 && !closed_) {
+    ++waiting_consumers_;
+    not_empty_.wait(lock, [this] { return items_.size() != 0 || closed_; });
+    --waiting_consumers_;
+  }
+  size_t count = std::min(max_count, items_.size());
+  if (count == 0) {
+    return 0;
+  }
+  Items::for_each_segment(items_.begin(), items_.begin() + count,
+                          [&out](T* span_first, T* span_last) {
+    out = std::move(span_first, span_last, out);
+    return span_last;
+  });
+  items_.pop_front(count);
+  WakeProducers(lock, count);
+  return count;
+}
+
+template<typename T, size_t BacketSize>
+void BlockingDeque<T, BacketSize>::close() {
+  {
+    std::lock_guard lock(mutex_);
+    closed_ = true;
+  }
+  not_full_.notify_all();
+  not_empty_.notify_all();
+}
+
+template<typename T, size_t BacketSize>
+size_t BlockingDeque<T, BacketSize>::size() const {
+  std::lock_guard lock(mutex_);
+  return items_.size();
+}
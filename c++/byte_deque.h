@@ -0,0 +1,93 @@
+#pragma once
+#include "deque.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <span>
+
+// Byte stream buffer over a Deque<char>: bytes are written at the back
+// and read or consumed at the front, a bucket span at a time with memcpy,
+// and searched with memchr. A parser can find a delimiter, then read
+// or peek the frame before it without copying the stream into a flat
+// buffer first. bytes() gives the Deque itself, for WriteDeque and the
+// other helpers of deque_io.h.
+template<typename Allocator = std::allocator<char>>
+class ByteDeque {
+ public:
+  using Bytes = Deque<char, Allocator>;
+
+  static constexpr size_t npos = static_cast<size_t>(-1);
+
+  ByteDeque() = default;
+  explicit ByteDeque(const Allocator& alloc): bytes_(alloc) {}
+
+  void write(const void* data, size_t count);
+  void write(std::span<const char> data) { write(data.data(), data.size()); }
+
+  // Copy up to count bytes from the front to out, return how many.
+  // read also removes them.
+  size_t read(void* out, size_t count);
+  size_t peek(void* out, size_t count) const;
+  // removes up to count bytes from the front
+  void consume(size_t count) { bytes_.pop_front(count); }
+
+  // position of the first delim at or after from, npos if there is none
+  size_t find(char delim, size_t from = 0) const;
+
+  char operator[](size_t pos) const { return bytes_[pos]; }
+  size_t size() const { return bytes_.size(); }
+  bool empty() const { return bytes_.size() == 0; }
+  void clear() { bytes_.clear(); }
+
+  Bytes& bytes() { return bytes_; }
+  const Bytes& bytes() const { return bytes_; }
+
+ private:
+  Bytes bytes_;
+};
+
+template<typename Allocator>
+void ByteDeque<Allocator>::write(const void* data, size_t count) {
+  const char* first = static_cast<const char*>(data);
+  bytes_.append(first, first + count);
+}
+
+template<typename Allocator>
+size_t ByteDeque<Allocator>::peek(void* out, size_t count) const {
+  count = std::min(count, bytes_.size());
+  char* place = static_cast<char*>(out);
+  Bytes::for_each_segment(bytes_.begin(), bytes_.begin() + count,
+                          [&place](const char* first, const char* last) {
+    std::memcpy(place, first, static_cast<size_t>(last - first));
+    place += last - first;
+    return last;
+  });
+  return count;
+}
+
+template<typename Allocator>
+size_t ByteDeque<Allocator>::read(void* out, size_t count) {
+  count = peek(out, count);
+  bytes_.pop_front(count);
+  return count;
+}
+
+template<typename Allocator>
+size_t ByteDeque<Allocator>::find(char delim, size_t from) const {
+  if (from >= bytes_.size()) {
+    return npos;
+  }
+  auto found = Bytes::for_each_segment(
+      bytes_.begin() + from, bytes_.end(),
+      [delim](const char* first, const char* last) {
+    const void* match =
+        std::memchr(first, delim, static_cast<size_t>(last - first));
+    return match == nullptr ? last : static_cast<const char*>(match);
+  });
+  if (found == bytes_.end()) {
+    return npos;
+  }
+  return static_cast<size_t>(found - bytes_.begin());
+}
@@ -0,0 +1,349 @@
+#pragma once
+#include "deque.h"
+
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+// Deque whose buckets are shared between copies. A copy takes a reference
+// to every bucket of the original, so it costs one counter increment per
+// bucket and no element is copied. A deque clones a bucket before it
+// changes it while other deques share it, so every copy keeps the
+// elements it was made with, whatever happens to the original later.
+// Elements are read only, the deque is changed at its ends.
+// A single CowDeque is not thread safe, but deques sharing buckets may be
+// used from different threads: a writer can hand a copy to a reader
+// thread and go on with its own deque without waiting for the reader.
+template<typename T, size_t BacketSize = DefaultDequeBacketSize<T>()>
+class CowDeque {
+ public:
+  CowDeque() = default;
+  CowDeque(const CowDeque& other);
+  CowDeque(CowDeque&& other) noexcept;
+  CowDeque& operator=(const CowDeque& other);
+  CowDeque& operator=(CowDeque&& other) noexcept;
+  ~CowDeque();
+
+  // changing an end clones its bucket if it is shared, so pops may
+  // allocate and throw too
+  void push_back(const T& value);
+  void push_back(T&& value);
+  void push_front(const T& value);
+  void push_front(T&& value);
+  template<typename... Args>
+  const T& emplace_back(Args&&... args);
+  template<typename... Args>
+  const T& emplace_front(Args&&... args);
+  void pop_back();
+  void pop_front();
+
+  const T& operator[](size_t pos) const;
+  const T& at(size_t pos) const;
+  const T& front() const { return (*this)[0]; }
+  const T& back() const { return (*this)[size_ - 1]; }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  class const_iterator {
+   public:
+    using reference = const T&;
+    using pointer = const T*;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using iterator_category = std::random_access_iterator_tag;
+
+    const_iterator() = default;
+    const_iterator(const CowDeque* owner, difference_type position)
+      : owner_(owner), position_(position)
+    {}
+
+    reference operator*() const {
+      return (*owner_)[static_cast<size_t>(position_)];
+    }
+    pointer operator->() const { return &**this; }
+    reference operator[](difference_type value) const {
+      return (*owner_)[static_cast<size_t>(position_ + value)];
+    }
+
+    const_iterator& operator++() { ++position_; return *this; }
+    const_iterator& operator--() { --position_; return *this; }
+    const_iterator operator++(int) { return {owner_, position_++}; }
+    const_iterator operator--(int) { return {owner_, position_--}; }
+    const_iterator& operator+=(difference_type value) {
+      position_ += value;
+      return *this;
+    }
+    const_iterator& operator-=(difference_type value) {
+      position_ -= value;
+      return *this;
+    }
+    const_iterator operator+(difference_type value) const {
+      return {owner_, position_ + value};
+    }
+    const_iterator operator-(difference_type value) const {
+      return {owner_, position_ - value};
+    }
+    friend const_iterator operator+(difference_type value,
+                                    const_iterator it) {
+      return it + value;
+    }
+    difference_type operator-(const_iterator other) const {
+      return position_ - other.position_;
+    }
+
+    bool operator==(const const_iterator& other) const {
+      return position_ == other.position_;
+    }
+    auto operator<=>(const const_iterator& other) const {
+      return position_ <=> other.position_;
+    }
+
+   private:
+    const CowDeque* owner_ = nullptr;
+    difference_type position_ = 0;
+  };
+
+  using iterator = const_iterator;
+
+  const_iterator begin() const { return {this, 0}; }
+  const_iterator end() const {
+    return {this, static_cast<std::ptrdiff_t>(size_)};
+  }
+  const_iterator cbegin() const { return begin(); }
+  const_iterator cend() const { return end(); }
+
+ private:
+  static const size_t kBacketSize = BacketSize;
+  static_assert(kBacketSize > 0, "bucket can't be empty");
+
+  // A bucket is changed only while a single deque refers to it. The
+  // elements in [begin, end) are constructed, the first bucket of a deque
+  // starts at its front element and the last one ends after its back one,
+  // buckets in between are full.
+  struct Backet {
+    explicit Backet(size_t index): begin(index), end(index) {}
+
+    T* values() { return std::launder(reinterpret_cast<T*>(storage)); }
+
+    std::atomic<size_t> references{1};
+    size_t begin;
+    size_t end;
+    alignas(T) unsigned char storage[sizeof(T) * kBacketSize];
+  };
+
+  static void Release(Backet* backet);
+  static Backet* Own(Backet*& backet);
+  void ReleaseAll();
+
+  Deque<Backet*> map_;
+  size_t size_ = 0;
+};
+
+template<typename T, size_t BacketSize>
+CowDeque<T, BacketSize>::CowDeque(const CowDeque& other):
+  map_(other.map_),
+  size_(other.size_)
+{
+  for (Backet* backet : map_) {
+    backet->references.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+template<typename T, size_t BacketSize>
+CowDeque<T, BacketSize>::CowDeque(CowDeque&& other) noexcept:
+  map_(std::move(other.map_)),
+  size_(std::exchange(other.size_, 0))
+{}
+
+template<typename T, size_t BacketSize>
+CowDeque<T, BacketSize>&
+CowDeque<T, BacketSize>::operator=(const CowDeque& other) {
+  if (this != &other) {
+    *this = CowDeque(other);
+  }
+  return *this;
+}
+
+template<typename T, size_t BacketSize>
+CowDeque<T, BacketSize>&
+CowDeque<T, BacketSize>::operator=(CowDeque&& other) noexcept {
+  if (this != &other) {
+    ReleaseAll();
+    map_ = std::move(other.map_);
+    size_ = std::exchange(other.size_, 0);
+  }
+  return *this;
+}
+
+template<typename T, size_t BacketSize>
+CowDeque<T, BacketSize>::~CowDeque() {
+  ReleaseAll();
+}
+
+template<typename T, size_t BacketSize>
+void CowDeque<T, BacketSize>::ReleaseAll() {
+  for (Backet* backet : map_) {
+    Release(backet);
+  }
+  map_.clear();
+  size_ = 0;
+}
+
+// The last deque to let go of a bucket destroys it, whichever thread it
+// is on.
+template<typename T, size_t BacketSize>
+void CowDeque<T, BacketSize>::Release(Backet* backet) {
+  if (backet->references.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+    return;
+  }
+  for (size_t i = backet->begin; i < backet->end; ++i) {
+    std::destroy_at(backet->values() + i);
+  }
+  delete backet;
+}
+
+// Makes backet one that no other deque refers to, by cloning it if it is
+// shared. Nobody else can start sharing a bucket only we refer to, so a
+// count of 1 stays 1 until we copy the deque ourselves.
+template<typename T, size_t BacketSize>
+typename CowDeque<T, BacketSize>::Backet*
+CowDeque<T, BacketSize>::Own(Backet*& backet) {
+  if (backet->references.load(std::memory_order_acquire) == 1) {
+    return backet;
+  }
+  Backet* clone = new Backet(backet->begin);
+  try {
+    for (; clone->end < backet->end; ++clone->end) {
+      std::construct_at(clone->values() + clone->end,
+                        backet->values()[clone->end]);
+    }
+  } catch (...) {
+    Release(clone);
+    throw;
+  }
+  Release(std::exchange(backet, clone));
+  return clone;
+}
+
+template<typename T, size_t BacketSize>
+void CowDeque<T, BacketSize>::push_back(const T& value) {
+  emplace_back(value);
+}
+
+template<typename T, size_t BacketSize>
+void CowDeque<T, BacketSize>::push_back(T&& value) {
+  emplace_back(std::move(value));
+}
+
+template<typename T, size_t BacketSize>
+void CowDeque<T, BacketSize>::push_front(const T& value) {
+  emplace_front(value);
+}
+
+template<typename T, size_t BacketSize>
+void CowDeque<T, BacketSize>::push_front(T&& value) {
+  emplace_front(std::move(value));
+}
+
+template<typename T, size_t BacketSize>
+template<typename... Args>
+const T& CowDeque<T, BacketSize>::emplace_back(Args&&... args) {
+  if (map_.size() == 0 || map_.back()->end == kBacketSize) {
+    // the first bucket leaves room for both ends
+    auto added = std::make_unique<Backet>(
+        map_.size() == 0 ? kBacketSize / 2 : 0);
+    map_.push_back(added.get());
+    added.release();
+  }
+  Backet* backet = Own(map_.back());
+  T* place = backet->values() + backet->end;
+  try {
+    std::construct_at(place, std::forward<Args>(args)...);
+  } catch (...) {
+    if (backet->begin == backet->end) {
+      map_.pop_back();
+      Release(backet);
+    }
+    throw;
+  }
+  ++backet->end;
+  ++size_;
+  return *place;
+}
+
+template<typename T, size_t BacketSize>
+template<typename... Args>
+const T& CowDeque<T, BacketSize>::emplace_front(Args&&... args) {
+  if (map_.size() == 0 || map_.front()->begin == 0) {
+    auto added = std::make_unique<Backet>(
+        map_.size() == 0 ? kBacketSize / 2 : kBacketSize);
+    map_.push_front(added.get());
+    added.release();
+  }
+  Backet* backet = Own(map_.front());
+  T* place = backet->values() + backet->begin - 1;
+  try {
+    std::construct_at(place, std::forward<Args>(args)...);
+  } catch (...) {
+    if (backet->begin == backet->end) {
+      map_.pop_front();
+      Release(backet);
+    }
+    throw;
+  }
+  --backet->begin;
+  ++size_;
+  return *place;
+}
+
+template<typename T, size_t BacketSize>
+void CowDeque<T, BacketSize>::pop_back() {
+  if (size_ == 0) {
+    return;
+  }
+  Backet* backet = map_.back();
+  if (backet->end - backet->begin == 1) {
+    // the whole bucket goes, nothing to clone
+    map_.pop_back();
+    Release(backet);
+  } else {
+    backet = Own(map_.back());
+    std::destroy_at(backet->values() + --backet->end);
+  }
+  --size_;
+}
+
+template<typename T, size_t BacketSize>
+void CowDeque<T, BacketSize>::pop_front() {
+  if (size_ == 0) {
+    return;
+  }
+  Backet* backet = map_.front();
+  if (backet->end - backet->begin == 1) {
+    map_.pop_front();
+    Release(backet);
+  } else {
+    backet = Own(map_.front());
+    std::destroy_at(backet->values() + backet->begin++);
+  }
+  --size_;
+}
+
+template<typename T, size_t BacketSize>
+const T& CowDeque<T, BacketSize>::operator[](size_t pos) const {
+  size_t global = map_.front()->begin + pos;
+  return map_[global / kBacketSize]->values()[global % kBacketSize];
+}
+
+template<typename T, size_t BacketSize>
+const T& CowDeque<T, BacketSize>::at(size_t pos) const {
+  if (pos >= size_) {
+    throw std::out_of_range("out_of_range");
+  }
+  return (*this)[pos];
+}
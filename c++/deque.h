@@ -1,36 +1,182 @@
 #pragma once
+#include "deque_statistics.h"
+
+#include <algorithm>
 #include <cstdint>
 #include <cstddef>
+#include <cstring>
 #include <iostream>
+#include <initializer_list>
 #include <iterator>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
 #include <utility>
 
+// Fields written by different threads in the concurrent deques are kept
+// this far apart so they don't share a cache line.
+inline constexpr size_t kCacheLineSize = 64;
+
+// Elements in one bucket by default: the largest power of two that keeps
+// a bucket within kDequeBacketBytes, at least kDequeMinBacketSize.
+// Power of two sizes turn index arithmetic into shifts and masks.
+inline constexpr size_t kDequeBacketBytes = 4096;
+inline constexpr size_t kDequeMinBacketSize = 16;
+
 template<typename T>
+constexpr size_t DefaultDequeBacketSize() {
+  size_t result = kDequeMinBacketSize;
+  while (result * 2 * sizeof(T) <= kDequeBacketBytes) {
+    result *= 2;
+  }
+  return result;
+}
+
+// Statistics is NoDequeStatistics or DequeStatistics, see
+// deque_statistics.h.
+template<typename T, typename Allocator = std::allocator<T>,
+         size_t BacketSize = DefaultDequeBacketSize<T>(),
+         typename Statistics = NoDequeStatistics>
 class Deque {
+  template<typename Iterator>
+  using RequireInputIterator = std::enable_if_t<std::is_convertible_v<
+      typename std::iterator_traits<Iterator>::iterator_category,
+      std::input_iterator_tag>>;
+
+  using AllocTraits = std::allocator_traits<Allocator>;
+  using MapAllocator = typename AllocTraits::template rebind_alloc<T*>;
+  using MapAllocTraits = std::allocator_traits<MapAllocator>;
+
+  // move assignment may steal the buckets of other
+  static constexpr bool kMoveAssignSteals =
+      AllocTraits::propagate_on_container_move_assignment::value ||
+      AllocTraits::is_always_equal::value;
+
+  // allocator without its own construct, elements can be created
+  // by std::uninitialized_* and memcpy
+  static constexpr bool kPlainConstruct =
+      !requires(Allocator& alloc, T* place) { alloc.construct(place); } &&
+      !requires(Allocator& alloc, T* place, const T& value) {
+        alloc.construct(place, value);
+      };
+
+  // elements are dropped without any call, nothing has to destroy them
+  static constexpr bool kTrivialDestroy =
+      std::is_trivially_destructible_v<T> &&
+      !requires(Allocator& alloc, T* place) { alloc.destroy(place); };
+
+  // elements are plain bytes: copied with memcpy and dropped without
+  // destructor calls
+  static constexpr bool kMemcpyElements =
+      kPlainConstruct && std::is_trivially_copyable_v<T> && kTrivialDestroy;
+
+  static constexpr bool kStatistics =
+      std::is_same_v<Statistics, DequeStatistics>;
+  static_assert(kStatistics || std::is_same_v<Statistics, NoDequeStatistics>,
+                "Statistics is NoDequeStatistics or DequeStatistics");
+
  public:
 // 0 .. num_backets - 1
 // 0 .. kBacketSize - 1
 
   void push_back(const T&);
+  void push_back(T&&);
   void push_front(const T&);
+  void push_front(T&&);
   void pop_front();
   void pop_back();
+  // Remove count elements, or all of them if there are fewer, destroying
+  // them a bucket at a time. The emptied buckets stay in the map as spares.
+  void pop_front(size_t count);
+  void pop_back(size_t count);
+  // The map and its buckets are kept, the ends are moved to its middle.
+  void clear();
+
+  // Move every element of other to the back or the front of this deque,
+  // other is left empty. When both deques have equal allocators and
+  // their elements sit at the same offsets within buckets, whole buckets
+  // change hands and only the bucket where the two meet is merged by
+  // moving elements, which is O(buckets). When the offsets differ the
+  // smaller deque is moved element by element, O(min(size(), other.size()));
+  // with unequal allocators all of other is moved, O(other.size()).
+  // split_at keeps those offsets, so its parts splice back bucket by bucket.
+  void splice_back(Deque<T, Allocator, BacketSize, Statistics>&& other);
+  void splice_front(Deque<T, Allocator, BacketSize, Statistics>&& other);
+  // Moves the elements from pos on to the returned deque. Their buckets
+  // change hands, only the bucket holding pos is split by moving elements.
+  Deque<T, Allocator, BacketSize, Statistics> split_at(size_t pos);
+
+  template<typename... Args>
+  T& emplace_back(Args&&... args);
+  template<typename... Args>
+  T& emplace_front(Args&&... args);
 
   T& operator[](size_t pos);
   const T& operator[](size_t pos) const;
-  Deque<T>& operator=(const Deque<T>&);
+  // keeps the buckets this deque already has and assigns in place
+  Deque<T, Allocator, BacketSize, Statistics>& operator=(
+      const Deque<T, Allocator, BacketSize, Statistics>&);
+  Deque<T, Allocator, BacketSize, Statistics>& operator=(
+      Deque<T, Allocator, BacketSize, Statistics>&&) noexcept(kMoveAssignSteals);
 
+  // nothing is allocated until the first element is added
   Deque();
-  Deque(const Deque<T>&);
-  Deque(size_t, const T&);
-  Deque(size_t);
+  explicit Deque(const Allocator&);
+  Deque(const Deque<T, Allocator, BacketSize, Statistics>&);
+  Deque(Deque<T, Allocator, BacketSize, Statistics>&&) noexcept;
+  Deque(size_t, const T&, const Allocator& = Allocator());
+  Deque(size_t, const Allocator& = Allocator());
+  template<typename InputIterator,
+           typename = RequireInputIterator<InputIterator>>
+  Deque(InputIterator first, InputIterator last,
+        const Allocator& = Allocator());
+  Deque(std::initializer_list<T>, const Allocator& = Allocator());
   ~Deque();
 
+  Allocator get_allocator() const;
+
+  // bulk operations construct whole buckets at once
+  void assign(size_t count, const T& value);
+  template<typename InputIterator,
+           typename = RequireInputIterator<InputIterator>>
+  void assign(InputIterator first, InputIterator last);
+  void assign(std::initializer_list<T>);
+  void resize(size_t count);
+  void resize(size_t count, const T& value);
+  // Like resize, but new elements are default initialized: trivial ones
+  // are left as the memory was, to be filled in place through segments().
+  void resize_for_overwrite(size_t count);
+  template<typename InputIterator,
+           typename = RequireInputIterator<InputIterator>>
+  void append(InputIterator first, InputIterator last);
+
   T& at(size_t pos);
   const T& at(size_t pos) const;
+  T& front();
+  const T& front() const;
+  T& back();
+  const T& back() const;
 
   size_t size() const;
 
+  // map grows by this factor when an end is reached, has to be > 1
+  void set_growth_factor(double factor);
+  double growth_factor() const;
+
+  // Frees every bucket that holds no elements and shrinks the map to the
+  // used ones, an empty deque frees the map too.
+  void shrink_to_fit();
+  // Opt-in trimming: once fewer than threshold of the allocated places
+  // are used, pop_front and pop_back compact the map to twice the used
+  // buckets and free the rest. The slack left keeps a queue hovering
+  // around the threshold from growing and trimming on every operation.
+  // 0 turns it off, has to be in [0, 0.5).
+  void set_trim_threshold(double threshold);
+  double trim_threshold() const;
+  // what this deque did so far, and what it holds now
+  DequeStatistics statistics() const requires kStatistics;
+
   template<bool is_const>
   struct base_iterator {
    public:
@@ -38,8 +184,10 @@ class Deque {
     using reference = std::conditional_t<is_const, const T&, T&>;
     using pointer = std::conditional_t<is_const, const T*, T*>;
     using value_type = T;
-    using difference_type = unsigned long;
+    using difference_type = std::ptrdiff_t;
     using iterator_category = std::random_access_iterator_tag;
+    // lets segmented algorithms find for_each_segment
+    using container_type = Deque;
 
     bool operator!=(base_iterator other) const;
     bool operator>(base_iterator other) const;
@@ -47,29 +195,46 @@ class Deque {
     bool operator>=(base_iterator other) const;
     bool operator<=(base_iterator other) const;
     bool operator==(base_iterator other) const;
-    size_t operator-(base_iterator other) const;
+    difference_type operator-(base_iterator other) const;
     base_iterator operator-(difference_type) const;
     base_iterator operator+(difference_type) const;
+    friend base_iterator operator+(difference_type value, base_iterator it) {
+      return it + value;
+    }
+    reference operator[](difference_type value) const;
+    base_iterator() = default;
     base_iterator(T** backet, size_t position);
     base_iterator(const base_iterator<false>& other)
-      : backet_(other.backet_)
-      , position_in_backet_(other.position_in_backet_)
+      : current_(other.current_)
+      , first_(other.first_)
+      , last_(other.last_)
+      , backet_(other.backet_)
     {}
     base_iterator operator++(int);
     base_iterator operator--(int);
     base_iterator& operator++();
     base_iterator& operator--();
-    base_iterator& operator+=(size_t);
-    base_iterator& operator-=(size_t);
+    base_iterator& operator+=(difference_type);
+    base_iterator& operator-=(difference_type);
     base_iterator& operator=(const base_iterator&) = default;
-    std::conditional_t<is_const, const T&, T&> operator*();
-    std::conditional_t<is_const, const T*, T*> operator->();
+    std::conditional_t<is_const, const T&, T&> operator*() const;
+    std::conditional_t<is_const, const T*, T*> operator->() const;
     ~base_iterator() = default;
 
    private:
-    
-    T** backet_;
-    size_t position_in_backet_;
+    template<bool>
+    friend struct base_iterator;
+    friend class Deque;
+
+    base_iterator(T** backet, T* current);
+    void SetBacket(T** backet);
+
+    // bounds of the current bucket are cached, so stepping and reading
+    // only touch the map when a bucket is left
+    T* current_ = nullptr;
+    T* first_ = nullptr;
+    T* last_ = nullptr;
+    T** backet_ = nullptr;
   };
 
   using iterator = base_iterator<false>;
@@ -90,12 +255,107 @@ class Deque {
   const_reverse_iterator rend() const { return std::make_reverse_iterator(begin()); }
   const_reverse_iterator rbegin() const { return std::make_reverse_iterator(end()); }
 
-  void insert(iterator, const T&);
-  void erase(iterator);
+  // Range over the used buckets, each element is a span of the values
+  // stored in one bucket, front to back. Invalidated like iterators.
+  template<bool is_const>
+  class base_segments {
+   public:
+    using span_type = std::span<std::conditional_t<is_const, const T, T>>;
+
+    class iterator {
+     public:
+      using value_type = span_type;
+      using reference = span_type;
+      using difference_type = std::ptrdiff_t;
+      using iterator_category = std::forward_iterator_tag;
+
+      iterator() = default;
+      span_type operator*() const {
+        size_t from = backet_ == first_ ? first_index_ : 0;
+        size_t to = backet_ + 1 == last_ ? last_index_ : kBacketSize;
+        return span_type(*backet_ + from, to - from);
+      }
+      iterator& operator++() {
+        ++backet_;
+        return *this;
+      }
+      iterator operator++(int) {
+        iterator temp = *this;
+        ++backet_;
+        return temp;
+      }
+      bool operator==(const iterator&) const = default;
+
+     private:
+      friend class base_segments;
+
+      T** backet_ = nullptr;
+      T** first_ = nullptr;
+      T** last_ = nullptr;
+      size_t first_index_ = 0;
+      size_t last_index_ = 0;
+    };
+
+    iterator begin() const { return Make(first_); }
+    iterator end() const { return Make(last_); }
+    size_t size() const { return last_ - first_; }
+    bool empty() const { return first_ == last_; }
+
+   private:
+    friend class Deque;
+
+    // [first, last) are the buckets holding elements, first_index is the
+    // first element in *first, last_index is one past the last in last[-1]
+    base_segments(T** first, size_t first_index, T** last, size_t last_index)
+      : first_(first), last_(last)
+      , first_index_(first_index), last_index_(last_index)
+    {}
+
+    iterator Make(T** backet) const {
+      iterator result;
+      result.backet_ = backet;
+      result.first_ = first_;
+      result.last_ = last_;
+      result.first_index_ = first_index_;
+      result.last_index_ = last_index_;
+      return result;
+    }
+
+    T** first_;
+    T** last_;
+    size_t first_index_;
+    size_t last_index_;
+  };
+
+  using segments_type = base_segments<false>;
+  using const_segments_type = base_segments<true>;
+
+  segments_type segments();
+  const_segments_type segments() const;
+
+  // elements are shifted toward the nearer end
+  iterator insert(iterator, const T&);
+  iterator insert(iterator, T&&);
+  template<typename InputIterator>
+  iterator insert(iterator, InputIterator first, InputIterator last);
+  iterator erase(iterator);
+  iterator erase(iterator first, iterator last);
+
+  // Calls visit(span_first, span_last) for every contiguous piece of
+  // [first, last) in order. visit returns where it stopped, span_last
+  // to go on, and the iterator to that place is returned.
+  template<bool is_const, typename Visit>
+  static base_iterator<is_const> for_each_segment(
+      base_iterator<is_const> first, base_iterator<is_const> last,
+      Visit visit);
 
  private:
 
-  static const size_t kBacketSize = 100;
+  static const size_t kBacketSize = BacketSize;
+  static_assert(kBacketSize > 0, "bucket can't be empty");
+  static constexpr double kDefaultGrowthFactor = 3;
+  // number_backets_ + 1 slots, the extra one repeats data_[0] so that an
+  // iterator stepping past the last bucket still has a bucket to point to
   T** data_;
 
   size_t number_backets_;
@@ -104,166 +364,434 @@ class Deque {
   size_t last_used_backet_;
   size_t last_non_used_index_;
   size_t size_;
-
-  void Swap(Deque<T>& , Deque<T>&);
+  double growth_factor_;
+  double trim_threshold_;
+  size_t trim_below_;        // trim once size_ gets below it
+  Allocator alloc_;
+  [[no_unique_address]] Statistics statistics_;
+
+  T* AllocateBacket();
+  void DeallocateBacket(T* backet);
+  void DeallocateMap(T** map, size_t count);
+  template<typename Make>
+  void ConstructEach(T* place, size_t count, Make make);
+
+  void Swap(Deque<T, Allocator, BacketSize, Statistics>&,
+            Deque<T, Allocator, BacketSize, Statistics>&);
+  void SwapStorage(Deque<T, Allocator, BacketSize, Statistics>& other);
+  bool SharesBackets(const Deque<T, Allocator, BacketSize, Statistics>& other) const;
+  void MoveBetweenBackets(T* from, T* to, size_t count);
+  void Recenter();
+  void DestroyElements(iterator first, iterator last);
   void FreeMemory();
   void GetNewCapacity(size_t new_size, T**& new_data, 
                       size_t& new_number_backets) const;
   void ResizeAndMove(size_t new_size);
-  void MoveValues(T**& new_data, size_t new_number_backets);
+  void MoveValues(T**& new_data, size_t new_number_backets,
+                  size_t new_first_backet);
+  size_t GrownCapacity() const;
+  void GrowOrRecenter();
+  void RotateMap(size_t new_first_backet);
+  void UpdateTrimBound();
+  void TrimMap();
+  void AllocateFor(size_t count, size_t first_index);
+  void ReserveBack(size_t count);
+  template<typename Construct>
+  void AppendByBackets(size_t count, Construct construct);
+
+  static T** EmptyMap();
+  T* Address(size_t pos) const;
+  size_t IndexInBacket(size_t pos) const;
+  void MoveElements(size_t from, size_t to, size_t count);
 };
 
-template<typename T>
-Deque<T>::~Deque() {
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+Deque<T, Allocator, BacketSize, Statistics>::~Deque() {
   FreeMemory();
 }
 
-template<typename T>
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
 template<bool is_const>
 std::conditional_t<is_const, const T&, T&>
-Deque<T>::base_iterator<is_const>::operator*() {
-  return (*backet_)[position_in_backet_];
+Deque<T, Allocator, BacketSize, Statistics>::base_iterator<is_const>::operator*() const {
+  return *current_;
 }
 
-template<typename T>
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
 template<bool is_const>
 std::conditional_t<is_const, const T*, T*>
-Deque<T>::base_iterator<is_const>::operator->() {
-  return &(*backet_)[position_in_backet_];
+Deque<T, Allocator, BacketSize, Statistics>::base_iterator<is_const>::operator->() const {
+  return current_;
 }
 
-template<typename T>
-void Deque<T>::FreeMemory() {
-  while (size_ != 0) {
-    pop_back();
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+void Deque<T, Allocator, BacketSize, Statistics>::DestroyElements(iterator first,
+                                                      iterator last) {
+  if constexpr (!kTrivialDestroy) {
+    for_each_segment(first, last, [this](T* span_first, T* span_last) {
+      for (T* element = span_first; element != span_last; ++element) {
+        AllocTraits::destroy(alloc_, element);
+      }
+      return span_last;
+    });
   }
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+void Deque<T, Allocator, BacketSize, Statistics>::FreeMemory() {
+  DestroyElements(begin(), end());
+  size_ = 0;
   for (size_t i = 0; i < number_backets_; ++i) {
-    delete [] reinterpret_cast<uint8_t*>(data_[i]);
+    DeallocateBacket(data_[i]);
   }
-  delete [] data_;
+  DeallocateMap(data_, number_backets_);
 }
 
-template<typename T>
-void Deque<T>::GetNewCapacity(size_t count, T**& new_data,
-                              size_t& new_number_backets) const {
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+T* Deque<T, Allocator, BacketSize, Statistics>::AllocateBacket() {
+  T* backet = AllocTraits::allocate(alloc_, kBacketSize);
+  if constexpr (kStatistics) {
+    ++statistics_.backets_allocated;
+  }
+  return backet;
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+void Deque<T, Allocator, BacketSize, Statistics>::DeallocateBacket(T* backet) {
+  AllocTraits::deallocate(alloc_, backet, kBacketSize);
+  if constexpr (kStatistics) {
+    ++statistics_.backets_freed;
+  }
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+void Deque<T, Allocator, BacketSize, Statistics>::DeallocateMap(T** map, size_t count) {
+  if (map != nullptr) {
+    MapAllocator map_alloc(alloc_);
+    MapAllocTraits::deallocate(map_alloc, map, count + 1);
+  }
+}
+
+// make(place) constructs one element, already made ones are destroyed
+// if it throws
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+template<typename Make>
+void Deque<T, Allocator, BacketSize, Statistics>::ConstructEach(T* place, size_t count,
+                                                    Make make) {
+  size_t made = 0;
+  try {
+    for (; made < count; ++made) {
+      make(place + made);
+    }
+  } catch (...) {
+    for (size_t i = 0; i < made; ++i) {
+      AllocTraits::destroy(alloc_, place + i);
+    }
+    throw;
+  }
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+void Deque<T, Allocator, BacketSize, Statistics>::GetNewCapacity(
+    size_t count, T**& new_data, size_t& new_number_backets) const {
   new_number_backets = (count + kBacketSize - 1) / kBacketSize;
-  new_data = new T* [new_number_backets];
+  MapAllocator map_alloc(alloc_);
+  new_data = MapAllocTraits::allocate(map_alloc, new_number_backets + 1);
 }
 
-template<typename T>
-void Deque<T>::ResizeAndMove(size_t element_count) {
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+void Deque<T, Allocator, BacketSize, Statistics>::ResizeAndMove(size_t element_count) {
   T** new_data;
   size_t new_number_backets;
   GetNewCapacity(element_count, new_data, new_number_backets);
-  MoveValues(new_data, new_number_backets);
+  size_t used_backets = last_used_backet_ - first_used_backet_ + 1;
+  MoveValues(new_data, new_number_backets,
+             (new_number_backets - used_backets) / 2);
 } 
 
-template<typename T>
-void Deque<T>::MoveValues(T**& new_data, size_t new_number_backets) {
-  size_t new_first_backet =
-      (new_number_backets - (last_used_backet_ - first_used_backet_)) / 2;
-  size_t new_last_backet =
-      new_first_backet + last_used_backet_ - first_used_backet_;
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+size_t Deque<T, Allocator, BacketSize, Statistics>::GrownCapacity() const {
+  size_t new_number_backets =
+      static_cast<size_t>(number_backets_ * growth_factor_);
+  // at least one new bucket on each side
+  return std::max(new_number_backets, number_backets_ + 2) * kBacketSize;
+}
 
-  if (data_ != nullptr) {
-    for (size_t i = first_used_backet_; i <= last_used_backet_; ++i) {
-      new_data[i - first_used_backet_ + new_first_backet] = data_[i];
+// Called when one end of the map is reached. While at most half of the
+// buckets are used they are recentered instead of growing the map, so a
+// deque used as a queue of bounded size stops allocating. Recentering
+// needs at least two free buckets to leave one at each end.
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+void Deque<T, Allocator, BacketSize, Statistics>::GrowOrRecenter() {
+  size_t used_backets = last_used_backet_ - first_used_backet_ + 1;
+  if (2 * used_backets <= number_backets_ &&
+      number_backets_ - used_backets >= 2) {
+    RotateMap((number_backets_ - used_backets) / 2);
+  } else {
+    ResizeAndMove(GrownCapacity());
+  }
+}
+
+// Moves the used buckets to start at new_first_backet. Only the pointers
+// in the map are rotated, the empty buckets in the way end up on the
+// other side.
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+void Deque<T, Allocator, BacketSize, Statistics>::RotateMap(size_t new_first_backet) {
+  if constexpr (kStatistics) {
+    ++statistics_.recenters;
+  }
+  DequeStatisticsTimer<Statistics> timer(statistics_);
+  size_t used_backets = last_used_backet_ - first_used_backet_ + 1;
+  T** first = data_ + first_used_backet_;
+  T** last = first + used_backets;
+  if (new_first_backet < first_used_backet_) {
+    std::rotate(data_ + new_first_backet, first, last);
+  } else {
+    std::rotate(first, last, last + (new_first_backet - first_used_backet_));
+  }
+  data_[number_backets_] = data_[0];
+  first_used_backet_ = new_first_backet;
+  last_used_backet_ = new_first_backet + used_backets - 1;
+}
+
+// Makes room for count elements after the last one, the front part of
+// the map is kept as it is.
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+void Deque<T, Allocator, BacketSize, Statistics>::ReserveBack(size_t count) {
+  if (data_ == nullptr) {
+    AllocateFor(count, 0);
+    return;
+  }
+  size_t free_places =
+      (number_backets_ - 1 - last_used_backet_) * kBacketSize +
+      kBacketSize - last_non_used_index_;
+  if (free_places >= count) {
+    return;
+  }
+  size_t missing_backets =
+      (count - free_places + kBacketSize - 1) / kBacketSize;
+  if (missing_backets <= first_used_backet_) {
+    // spare buckets before the first one are enough
+    RotateMap(first_used_backet_ - missing_backets);
+    return;
+  }
+  T** new_data;
+  size_t new_number_backets;
+  GetNewCapacity((number_backets_ + missing_backets) * kBacketSize,
+                 new_data, new_number_backets);
+  MoveValues(new_data, new_number_backets, first_used_backet_);
+}
+
+// First allocation of an empty deque without a map. The map is sized
+// for count elements which start at place first_index of its first bucket.
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+void Deque<T, Allocator, BacketSize, Statistics>::AllocateFor(size_t count,
+                                                  size_t first_index) {
+  if (count == 0) {
+    return;
+  }
+  T** new_data;
+  size_t new_number_backets;
+  GetNewCapacity(first_index + count, new_data, new_number_backets);
+  first_used_backet_ = last_used_backet_ = 0;
+  first_used_index_ = last_non_used_index_ = first_index;
+  MoveValues(new_data, new_number_backets, 0);
+}
+
+// construct(place, n) has to construct n elements at place or to throw
+// without leaving any of them. Counters are updated after every bucket,
+// so the deque stays consistent when construct throws.
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+template<typename Construct>
+void Deque<T, Allocator, BacketSize, Statistics>::AppendByBackets(size_t count,
+                                           Construct construct) {
+  ReserveBack(count);
+  while (count != 0) {
+    if (last_non_used_index_ == kBacketSize) {
+      ++last_used_backet_;
+      last_non_used_index_ = 0;
+    }
+    size_t chunk = std::min(count, kBacketSize - last_non_used_index_);
+    construct(&data_[last_used_backet_][last_non_used_index_], chunk);
+    last_non_used_index_ += chunk;
+    size_ += chunk;
+    count -= chunk;
+  }
+}
+
+// Spare buckets of the old map are carried over to the new one, only
+// missing buckets are allocated and only extra ones are freed.
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+void Deque<T, Allocator, BacketSize, Statistics>::MoveValues(T**& new_data,
+                                      size_t new_number_backets,
+                                      size_t new_first_backet) {
+  if constexpr (kStatistics) {
+    if (data_ != nullptr && new_number_backets > number_backets_) {
+      ++statistics_.regrows;
     }
-    //TODO
-    //smart move visout deleteing memory
-    for (size_t i = 0; i < first_used_backet_; ++i) {
-      delete [] reinterpret_cast<uint8_t*>(data_[i]);
+    statistics_.peak_map_backets =
+        std::max<uint64_t>(statistics_.peak_map_backets, new_number_backets);
+  }
+  DequeStatisticsTimer<Statistics> timer(statistics_);
+  size_t used_backets = last_used_backet_ - first_used_backet_ + 1;
+  size_t new_last_backet = new_first_backet + used_backets - 1;
+
+  if (data_ == nullptr) {
+    size_t allocated = 0;
+    try {
+      for (; allocated < new_number_backets; ++allocated) {
+        new_data[allocated] = AllocateBacket();
+      }
+    } catch (...) {
+      for (size_t i = 0; i < allocated; ++i) {
+        DeallocateBacket(new_data[i]);
+      }
+      DeallocateMap(new_data, new_number_backets);
+      throw;
     }
-    for (size_t i = last_used_backet_ + 1; i < number_backets_; ++i) {
-      delete [] reinterpret_cast<uint8_t*>(data_[i]);
+  } else {
+    // spare slots of both maps are enumerated as
+    // [0, first) and then (last, number_backets)
+    auto old_spare = [&](size_t k) {
+      return k < first_used_backet_ ? k : k + used_backets;
+    };
+    auto new_spare = [&](size_t k) {
+      return k < new_first_backet ? k : k + used_backets;
+    };
+    size_t old_spare_count = number_backets_ - used_backets;
+    size_t new_spare_count = new_number_backets - used_backets;
+    size_t reused = std::min(old_spare_count, new_spare_count);
+
+    size_t allocated = reused;
+    try {
+      for (; allocated < new_spare_count; ++allocated) {
+        new_data[new_spare(allocated)] = AllocateBacket();
+      }
+    } catch (...) {
+      for (size_t k = reused; k < allocated; ++k) {
+        DeallocateBacket(new_data[new_spare(k)]);
+      }
+      DeallocateMap(new_data, new_number_backets);
+      throw;
     }
-    for (size_t i = 0; i < new_first_backet; ++i) {
-      new_data[i] = 
-          reinterpret_cast<T*>(new uint8_t [kBacketSize * sizeof(T)]);
+    for (size_t k = 0; k < reused; ++k) {
+      new_data[new_spare(k)] = data_[old_spare(k)];
     }
-    for (size_t i = new_last_backet + 1; i < new_number_backets; ++i) {
-      new_data[i] = 
-          reinterpret_cast<T*>(new uint8_t [kBacketSize * sizeof(T)]);
+    for (size_t k = reused; k < old_spare_count; ++k) {
+      DeallocateBacket(data_[old_spare(k)]);
     }
-  } else {
-    new_data[0] =
-          reinterpret_cast<T*>(new uint8_t [kBacketSize * sizeof(T)]);
+    std::copy(data_ + first_used_backet_, data_ + last_used_backet_ + 1,
+              new_data + new_first_backet);
+    DeallocateMap(data_, number_backets_);
   }
 
   number_backets_ = new_number_backets;
   data_ = new_data;
+  data_[number_backets_] = data_[0];
   first_used_backet_ = new_first_backet;
   last_used_backet_ = new_last_backet;
+  UpdateTrimBound();
 }
 
-template<typename T>
-Deque<T>::Deque():
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+Deque<T, Allocator, BacketSize, Statistics>::Deque():
+  Deque(Allocator())
+{}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+Deque<T, Allocator, BacketSize, Statistics>::Deque(const Allocator& alloc):
   data_(nullptr),
   number_backets_(0),
   first_used_backet_(0),
   first_used_index_(kBacketSize / 2),
   last_used_backet_(0),
   last_non_used_index_(kBacketSize / 2),
-  size_(0)
-{
-  ResizeAndMove(kBacketSize);
+  size_(0),
+  growth_factor_(kDefaultGrowthFactor),
+  trim_threshold_(0),
+  trim_below_(0),
+  alloc_(alloc)
+{}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+Allocator Deque<T, Allocator, BacketSize, Statistics>::get_allocator() const {
+  return alloc_;
 }
 
-// copypast 
-template<typename T>
-T& Deque<T>::operator[](size_t pos) {
-  if (first_used_index_ + pos < kBacketSize) {
-    return data_[first_used_backet_][first_used_index_ + pos];
-  } else {
-    pos -= kBacketSize - first_used_index_;
-    size_t shift = 1;                     // need because first backet non used
-    return data_[first_used_backet_ + shift + pos / kBacketSize]
-                [pos % kBacketSize];
-  }
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+T& Deque<T, Allocator, BacketSize, Statistics>::operator[](size_t pos) {
+  return *Address(pos);
 }
 
-template<typename T>
-const T& Deque<T>::operator[](size_t pos) const { 
-  if (first_used_index_ + pos < kBacketSize) {
-    return data_[first_used_backet_][first_used_index_ + pos];
-  } else {
-    pos -= kBacketSize - first_used_index_;
-    size_t shift = 1;                     // need because first backet non used
-    return data_[first_used_backet_ + shift + pos / kBacketSize]
-                [pos % kBacketSize];
-  }
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+const T& Deque<T, Allocator, BacketSize, Statistics>::operator[](size_t pos) const { 
+  return *Address(pos);
 }
 
-template<typename T>
-void Deque<T>::push_back(const T& value) {
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+void Deque<T, Allocator, BacketSize, Statistics>::push_back(const T& value) {
+  emplace_back(value);
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+void Deque<T, Allocator, BacketSize, Statistics>::push_back(T&& value) {
+  emplace_back(std::move(value));
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+void Deque<T, Allocator, BacketSize, Statistics>::push_front(const T& value) {
+  emplace_front(value);
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+void Deque<T, Allocator, BacketSize, Statistics>::push_front(T&& value) {
+  emplace_front(std::move(value));
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+template<typename... Args>
+T& Deque<T, Allocator, BacketSize, Statistics>::emplace_back(Args&&... args) {
+  if (data_ == nullptr) {               // nothing allocated yet
+    ResizeAndMove(kBacketSize);
+  }
   if (last_non_used_index_ == kBacketSize) {
     if (last_used_backet_ == number_backets_ - 1) {
-      ResizeAndMove(number_backets_ * 3 * kBacketSize);
+      GrowOrRecenter();
     }
     ++last_used_backet_;
 
     last_non_used_index_ = 0;
   }
-  new(&data_[last_used_backet_][last_non_used_index_]) T(value);
+  T* place = &data_[last_used_backet_][last_non_used_index_];
+  AllocTraits::construct(alloc_, place, std::forward<Args>(args)...);
   ++last_non_used_index_;
   ++size_;
+  return *place;
 }
 
-template<typename T>
-void Deque<T>::push_front(const T& value) {
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+template<typename... Args>
+T& Deque<T, Allocator, BacketSize, Statistics>::emplace_front(Args&&... args) {
+  if (data_ == nullptr) {
+    ResizeAndMove(kBacketSize);
+  }
   if (first_used_index_ == 0) {
     if (first_used_backet_ == 0) {
-      ResizeAndMove(number_backets_ * 3 * kBacketSize);
+      GrowOrRecenter();
     }
     --first_used_backet_;
     first_used_index_ = kBacketSize;
   }
-  new(&data_[first_used_backet_][--first_used_index_]) T(value);
+  // index is moved only after constructor succeeded
+  T* place = &data_[first_used_backet_][first_used_index_ - 1];
+  AllocTraits::construct(alloc_, place, std::forward<Args>(args)...);
+  --first_used_index_;
   ++size_;
+  return *place;
 }
 
-template<typename T>
-void Deque<T>::pop_back() {
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+void Deque<T, Allocator, BacketSize, Statistics>::pop_back() {
   if (size_ == 0) {
     return;
   }
@@ -271,12 +799,16 @@ void Deque<T>::pop_back() {
     --last_used_backet_;
     last_non_used_index_ = kBacketSize;
   }
-  data_[last_used_backet_][--last_non_used_index_].~T();
+  --last_non_used_index_;
+  AllocTraits::destroy(alloc_, &data_[last_used_backet_][last_non_used_index_]);
   --size_;
+  if (size_ < trim_below_) {
+    TrimMap();
+  }
 }
 
-template<typename T>
-void Deque<T>::pop_front() {
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+void Deque<T, Allocator, BacketSize, Statistics>::pop_front() {
   if (size_ == 0) {
     return;
   }
@@ -284,26 +816,271 @@ void Deque<T>::pop_front() {
     ++first_used_backet_;
     first_used_index_ = 0;
   }
-  data_[first_used_backet_][first_used_index_++].~T();
+  AllocTraits::destroy(alloc_, &data_[first_used_backet_][first_used_index_++]);
   --size_;
   if (first_used_index_ == kBacketSize) { ++first_used_backet_; first_used_index_ = 0; }
+  if (size_ < trim_below_) {
+    TrimMap();
+  }
 }
 
-template<typename T>
-Deque<T>::Deque(const Deque<T>& other):
-  Deque()  
-{
-  ResizeAndMove(other.number_backets_ * kBacketSize);
-  first_used_index_ = last_non_used_index_ = other.first_used_index_;
-  first_used_backet_ = last_used_backet_ = other.first_used_backet_;
+// Both ends end up where count single pops would have left them.
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+void Deque<T, Allocator, BacketSize, Statistics>::pop_front(size_t count) {
+  count = std::min(count, size_);
+  if (count == 0) {
+    return;
+  }
+  DestroyElements(begin(), begin() + count);
+  size_t front = first_used_backet_ * kBacketSize + first_used_index_ + count;
+  first_used_backet_ = front / kBacketSize;
+  first_used_index_ = front % kBacketSize;
+  size_ -= count;
+  if (size_ < trim_below_) {
+    TrimMap();
+  }
+}
 
-  for (size_t i = 0; i < other.size(); ++i) {
-    this->push_back(other[i]);
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+void Deque<T, Allocator, BacketSize, Statistics>::pop_back(size_t count) {
+  count = std::min(count, size_);
+  if (count == 0) {
+    return;
+  }
+  DestroyElements(end() - count, end());
+  size_t back =
+      last_used_backet_ * kBacketSize + last_non_used_index_ - count;
+  last_used_backet_ = back / kBacketSize;
+  last_non_used_index_ = back % kBacketSize;
+  size_ -= count;
+  if (size_ < trim_below_) {
+    TrimMap();
   }
 }
 
-template<typename T>
-void Deque<T>::Swap(Deque<T>& first, Deque<T>& second) {
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+void Deque<T, Allocator, BacketSize, Statistics>::clear() {
+  if (data_ == nullptr) {
+    return;
+  }
+  DestroyElements(begin(), end());
+  size_ = 0;
+  Recenter();
+  if (trim_below_ > 0) {
+    TrimMap();
+  }
+}
+
+// Puts both ends of an empty deque in the middle of its map.
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+void Deque<T, Allocator, BacketSize, Statistics>::Recenter() {
+  first_used_backet_ = last_used_backet_ = number_backets_ / 2;
+  first_used_index_ = last_non_used_index_ = kBacketSize / 2;
+}
+
+// Exchanges the maps with their buckets and elements, the allocators and
+// the settings stay.
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+void Deque<T, Allocator, BacketSize, Statistics>::SwapStorage(
+    Deque<T, Allocator, BacketSize, Statistics>& other) {
+  std::swap(data_, other.data_);
+  std::swap(number_backets_, other.number_backets_);
+  std::swap(first_used_backet_, other.first_used_backet_);
+  std::swap(first_used_index_, other.first_used_index_);
+  std::swap(last_used_backet_, other.last_used_backet_);
+  std::swap(last_non_used_index_, other.last_non_used_index_);
+  std::swap(size_, other.size_);
+  UpdateTrimBound();
+  other.UpdateTrimBound();
+}
+
+// buckets of other may be freed by our allocator and the other way round
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+bool Deque<T, Allocator, BacketSize, Statistics>::SharesBackets(
+    const Deque<T, Allocator, BacketSize, Statistics>& other) const {
+  return AllocTraits::is_always_equal::value || alloc_ == other.alloc_;
+}
+
+// Moves count elements from one bucket to the same places of another one
+// and destroys the sources.
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+void Deque<T, Allocator, BacketSize, Statistics>::MoveBetweenBackets(T* from, T* to,
+                                                         size_t count) {
+  if constexpr (kMemcpyElements) {
+    std::memcpy(static_cast<void*>(to), from, count * sizeof(T));
+  } else {
+    ConstructEach(to, count, [this, from, to](T* place) {
+      AllocTraits::construct(alloc_, place, std::move(from[place - to]));
+    });
+    if constexpr (!kTrivialDestroy) {
+      for (size_t i = 0; i < count; ++i) {
+        AllocTraits::destroy(alloc_, from + i);
+      }
+    }
+  }
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+void Deque<T, Allocator, BacketSize, Statistics>::splice_back(
+    Deque<T, Allocator, BacketSize, Statistics>&& other) {
+  if (this == &other || other.size_ == 0) {
+    return;
+  }
+  if (!SharesBackets(other)) {
+    append(std::make_move_iterator(other.begin()),
+           std::make_move_iterator(other.end()));
+    other.clear();
+    return;
+  }
+  if (size_ == 0) {
+    SwapStorage(other);
+    return;
+  }
+  size_t front = other.first_used_backet_ * kBacketSize +
+                 other.first_used_index_;
+  if (last_non_used_index_ % kBacketSize != front % kBacketSize) {
+    // every element of one deque has to shift, the smaller one moves
+    if (other.size_ <= size_) {
+      append(std::make_move_iterator(other.begin()),
+             std::make_move_iterator(other.end()));
+      other.clear();
+    } else {
+      for (size_t i = size_; i > 0; --i) {
+        other.emplace_front(std::move(*Address(i - 1)));
+      }
+      clear();
+      SwapStorage(other);
+    }
+    return;
+  }
+  size_t count = other.size_;
+  ReserveBack(count);
+  size_t mine = first_used_backet_ * kBacketSize + first_used_index_;
+  size_t end = last_used_backet_ * kBacketSize + last_non_used_index_;
+  size_t offset = end % kBacketSize;
+  size_t backets = (offset + count + kBacketSize - 1) / kBacketSize;
+  T** ours = data_ + end / kBacketSize;
+  T** theirs = other.data_ + front / kBacketSize;
+  size_t swapped = 0;
+  if (offset != 0) {
+    // the bucket where the deques meet gets the fewer elements moved
+    size_t our_first = std::max(mine, end - offset) % kBacketSize;
+    size_t our_count = offset - our_first;
+    size_t their_count = std::min(count, kBacketSize - offset);
+    if (our_count <= their_count) {
+      MoveBetweenBackets(ours[0] + our_first, theirs[0] + our_first,
+                         our_count);
+      std::swap(ours[0], theirs[0]);
+    } else {
+      MoveBetweenBackets(theirs[0] + offset, ours[0] + offset, their_count);
+    }
+    swapped = 1;
+  }
+  // our spare buckets go to other in exchange
+  for (; swapped < backets; ++swapped) {
+    std::swap(ours[swapped], theirs[swapped]);
+  }
+  data_[number_backets_] = data_[0];
+  other.data_[other.number_backets_] = other.data_[0];
+  last_used_backet_ = (end + count - 1) / kBacketSize;
+  last_non_used_index_ = (end + count - 1) % kBacketSize + 1;
+  size_ += count;
+  other.size_ = 0;
+  other.Recenter();
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+void Deque<T, Allocator, BacketSize, Statistics>::splice_front(
+    Deque<T, Allocator, BacketSize, Statistics>&& other) {
+  if (this == &other || other.size_ == 0) {
+    return;
+  }
+  if (!SharesBackets(other)) {
+    for (size_t i = other.size_; i > 0; --i) {
+      emplace_front(std::move(*other.Address(i - 1)));
+    }
+    other.clear();
+    return;
+  }
+  other.splice_back(std::move(*this));
+  SwapStorage(other);
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+Deque<T, Allocator, BacketSize, Statistics>
+Deque<T, Allocator, BacketSize, Statistics>::split_at(size_t pos) {
+  if (pos > size_) {
+    throw std::out_of_range("out_of_range");
+  }
+  Deque<T, Allocator, BacketSize, Statistics> result(alloc_);
+  result.growth_factor_ = growth_factor_;
+  result.set_trim_threshold(trim_threshold_);
+  size_t count = size_ - pos;
+  if (count == 0) {
+    return result;
+  }
+  if (pos == 0) {
+    result.SwapStorage(*this);
+    return result;
+  }
+  size_t front = first_used_backet_ * kBacketSize + first_used_index_;
+  size_t at = front + pos;
+  size_t offset = at % kBacketSize;
+  // fresh buckets for the result, they become our spares in exchange
+  result.AllocateFor(count, offset);
+  size_t backets = (offset + count + kBacketSize - 1) / kBacketSize;
+  T** ours = data_ + at / kBacketSize;
+  T** theirs = result.data_;
+  size_t swapped = 0;
+  if (offset != 0) {
+    size_t kept_first = std::max(front, at - offset) % kBacketSize;
+    size_t kept = offset - kept_first;
+    size_t moved = std::min(count, kBacketSize - offset);
+    if (moved <= kept) {
+      MoveBetweenBackets(ours[0] + offset, theirs[0] + offset, moved);
+    } else {
+      MoveBetweenBackets(ours[0] + kept_first, theirs[0] + kept_first, kept);
+      std::swap(ours[0], theirs[0]);
+    }
+    swapped = 1;
+  }
+  for (; swapped < backets; ++swapped) {
+    std::swap(ours[swapped], theirs[swapped]);
+  }
+  data_[number_backets_] = data_[0];
+  result.data_[result.number_backets_] = result.data_[0];
+  result.last_used_backet_ = (offset + count - 1) / kBacketSize;
+  result.last_non_used_index_ = (offset + count - 1) % kBacketSize + 1;
+  result.size_ = count;
+  last_used_backet_ = at / kBacketSize;
+  last_non_used_index_ = offset;
+  size_ = pos;
+  if (size_ < trim_below_) {
+    TrimMap();
+  }
+  return result;
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+Deque<T, Allocator, BacketSize, Statistics>::Deque(
+    const Deque<T, Allocator, BacketSize, Statistics>& other):
+  Deque(AllocTraits::select_on_container_copy_construction(other.alloc_))
+{
+  growth_factor_ = other.growth_factor_;
+  set_trim_threshold(other.trim_threshold_);
+  if (other.size_ == 0) {
+    return;
+  }
+  // only the used buckets, elements keep their places in them so every
+  // bucket is copied in one piece
+  AllocateFor(other.size_, other.first_used_index_ % kBacketSize);
+  append(other.begin(), other.end());
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+void Deque<T, Allocator, BacketSize, Statistics>::Swap(
+    Deque<T, Allocator, BacketSize, Statistics>& first,
+    Deque<T, Allocator, BacketSize, Statistics>& second) {
   std::swap(first.data_, second.data_);
   std::swap(first.number_backets_, second.number_backets_);
   std::swap(first.first_used_backet_, second.first_used_backet_);
@@ -311,17 +1088,75 @@ void Deque<T>::Swap(Deque<T>& first, Deque<T>& second) {
   std::swap(first.last_used_backet_, second.last_used_backet_);
   std::swap(first.last_non_used_index_, second.last_non_used_index_);
   std::swap(first.size_, second.size_);
+  std::swap(first.growth_factor_, second.growth_factor_);
+  std::swap(first.trim_threshold_, second.trim_threshold_);
+  std::swap(first.trim_below_, second.trim_below_);
+  std::swap(first.alloc_, second.alloc_);
 }
 
-template<typename T>
-Deque<T>& Deque<T>::operator=(const Deque<T>& other) {
-  Deque<T> temp = other;
-  Swap(*this, temp);
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+Deque<T, Allocator, BacketSize, Statistics>::Deque(
+    Deque<T, Allocator, BacketSize, Statistics>&& other) noexcept:
+  data_(nullptr),
+  number_backets_(0),
+  first_used_backet_(0),
+  first_used_index_(kBacketSize / 2),
+  last_used_backet_(0),
+  last_non_used_index_(kBacketSize / 2),
+  size_(0),
+  growth_factor_(kDefaultGrowthFactor),
+  trim_threshold_(0),
+  trim_below_(0),
+  alloc_(other.alloc_)
+{
+  Swap(*this, other);
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+Deque<T, Allocator, BacketSize, Statistics>&
+Deque<T, Allocator, BacketSize, Statistics>::operator=(
+    const Deque<T, Allocator, BacketSize, Statistics>& other) {
+  if (this == &other) {
+    return *this;
+  }
+  if (AllocTraits::propagate_on_container_copy_assignment::value &&
+      alloc_ != other.alloc_) {
+    // our buckets can't be kept, they belong to the old allocator
+    Deque<T, Allocator, BacketSize, Statistics> temp(other.alloc_);
+    temp.growth_factor_ = other.growth_factor_;
+    temp.set_trim_threshold(other.trim_threshold_);
+    temp.append(other.begin(), other.end());
+    Swap(*this, temp);
+    return *this;
+  }
+  // buckets and elements already here are reused
+  growth_factor_ = other.growth_factor_;
+  set_trim_threshold(other.trim_threshold_);
+  assign(other.begin(), other.end());
   return *this;
 }
 
-template<typename T>
-size_t Deque<T>::size() const {
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+Deque<T, Allocator, BacketSize, Statistics>&
+Deque<T, Allocator, BacketSize, Statistics>::operator=(
+    Deque<T, Allocator, BacketSize, Statistics>&& other) noexcept(kMoveAssignSteals) {
+  if (kMoveAssignSteals || alloc_ == other.alloc_) {
+    Deque<T, Allocator, BacketSize, Statistics> temp = std::move(other);
+    Swap(*this, temp);
+  } else {
+    // buckets of other can't be freed by our allocator
+    Deque<T, Allocator, BacketSize, Statistics> temp(alloc_);
+    temp.growth_factor_ = other.growth_factor_;
+    temp.set_trim_threshold(other.trim_threshold_);
+    temp.append(std::make_move_iterator(other.begin()),
+                std::make_move_iterator(other.end()));
+    Swap(*this, temp);
+  }
+  return *this;
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+size_t Deque<T, Allocator, BacketSize, Statistics>::size() const {
   /*
   if (first_used_backet_ == last_used_backet_) {
     return last_non_used_index_ - first_used_index_;
@@ -334,245 +1169,770 @@ size_t Deque<T>::size() const {
   return size_;
 }
 
-template<typename T>
-Deque<T>::Deque(size_t count, const T& value):
-  Deque()
-{
-  for (size_t i = 0; i < count; ++i) {
-    this->push_back(value);
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+void Deque<T, Allocator, BacketSize, Statistics>::set_growth_factor(double factor) {
+  if (!(factor > 1)) {
+    throw std::invalid_argument("growth factor has to be greater than 1");
   }
+  growth_factor_ = factor;
 }
 
-template<typename T>
-Deque<T>::Deque(size_t count):
-  Deque()
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+double Deque<T, Allocator, BacketSize, Statistics>::growth_factor() const {
+  return growth_factor_;
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+void Deque<T, Allocator, BacketSize, Statistics>::shrink_to_fit() {
+  if (data_ == nullptr) {
+    return;
+  }
+  if (size_ == 0) {
+    // back to the state of a new deque
+    FreeMemory();
+    data_ = nullptr;
+    number_backets_ = 0;
+    first_used_backet_ = last_used_backet_ = 0;
+    first_used_index_ = last_non_used_index_ = kBacketSize / 2;
+    UpdateTrimBound();
+    return;
+  }
+  size_t used_backets = last_used_backet_ - first_used_backet_ + 1;
+  if (used_backets < number_backets_) {
+    ResizeAndMove(used_backets * kBacketSize);
+  }
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+void Deque<T, Allocator, BacketSize, Statistics>::set_trim_threshold(double threshold) {
+  if (!(threshold >= 0 && threshold < 0.5)) {
+    throw std::invalid_argument("trim threshold has to be in [0, 0.5)");
+  }
+  trim_threshold_ = threshold;
+  UpdateTrimBound();
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+double Deque<T, Allocator, BacketSize, Statistics>::trim_threshold() const {
+  return trim_threshold_;
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+DequeStatistics Deque<T, Allocator, BacketSize, Statistics>::statistics() const
+    requires kStatistics {
+  DequeStatistics result = statistics_;
+  size_t used_backets =
+      size_ == 0 ? 0 : last_used_backet_ - first_used_backet_ + 1;
+  result.map_backets = number_backets_;
+  result.idle_backets = number_backets_ - used_backets;
+  result.bytes_reserved = number_backets_ * kBacketSize * sizeof(T);
+  if (data_ != nullptr) {
+    result.bytes_reserved += (number_backets_ + 1) * sizeof(T*);
+  }
+  result.bytes_used = size_ * sizeof(T);
+  return result;
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+void Deque<T, Allocator, BacketSize, Statistics>::UpdateTrimBound() {
+  trim_below_ = static_cast<size_t>(
+      trim_threshold_ * static_cast<double>(number_backets_ * kBacketSize));
+}
+
+// Called by pops once size_ < trim_below_. Trimming is best effort, pops
+// don't fail if the smaller map can't be allocated.
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+void Deque<T, Allocator, BacketSize, Statistics>::TrimMap() {
+  size_t used_backets = last_used_backet_ - first_used_backet_ + 1;
+  size_t new_number_backets = 2 * used_backets + 2;
+  if (new_number_backets >= number_backets_) {
+    // nothing to gain, wait until the map grows again
+    trim_below_ = 0;
+    return;
+  }
+  try {
+    ResizeAndMove(new_number_backets * kBacketSize);
+  } catch (...) {
+    trim_below_ = 0;
+  }
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+Deque<T, Allocator, BacketSize, Statistics>::Deque(size_t count, const T& value,
+                                       const Allocator& alloc):
+  Deque(alloc)
 {
-  ResizeAndMove(count);
-  for (size_t i = 0; i < count; ++i) {
-    push_back(T());
+  resize(count, value);
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+Deque<T, Allocator, BacketSize, Statistics>::Deque(size_t count, const Allocator& alloc):
+  Deque(alloc)
+{
+  resize(count);
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+template<typename InputIterator, typename>
+Deque<T, Allocator, BacketSize, Statistics>::Deque(InputIterator first,
+                                       InputIterator last,
+                                       const Allocator& alloc):
+  Deque(alloc)
+{
+  append(first, last);
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+Deque<T, Allocator, BacketSize, Statistics>::Deque(std::initializer_list<T> values,
+                                       const Allocator& alloc):
+  Deque(values.begin(), values.end(), alloc)
+{}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+void Deque<T, Allocator, BacketSize, Statistics>::resize(size_t count) {
+  if (size_ > count) {
+    pop_back(size_ - count);
   }
+  AppendByBackets(count - size_, [this](T* place, size_t n) {
+    if constexpr (kPlainConstruct) {
+      std::uninitialized_value_construct_n(place, n);
+    } else {
+      ConstructEach(place, n, [this](T* element) {
+        AllocTraits::construct(alloc_, element);
+      });
+    }
+  });
 }
 
-template<typename T>
-const T& Deque<T>::at(size_t pos) const {
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+void Deque<T, Allocator, BacketSize, Statistics>::resize_for_overwrite(size_t count) {
+  if (size_ > count) {
+    pop_back(size_ - count);
+  }
+  AppendByBackets(count - size_, [this](T* place, size_t n) {
+    if constexpr (kPlainConstruct) {
+      std::uninitialized_default_construct_n(place, n);
+    } else {
+      // an allocator's construct always value initializes
+      ConstructEach(place, n, [this](T* element) {
+        AllocTraits::construct(alloc_, element);
+      });
+    }
+  });
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+void Deque<T, Allocator, BacketSize, Statistics>::resize(size_t count, const T& value) {
+  if (size_ > count) {
+    pop_back(size_ - count);
+  }
+  AppendByBackets(count - size_, [this, &value](T* place, size_t n) {
+    if constexpr (!kPlainConstruct) {
+      ConstructEach(place, n, [this, &value](T* element) {
+        AllocTraits::construct(alloc_, element, value);
+      });
+    } else if constexpr (std::is_trivially_copyable_v<T> && sizeof(T) == 1) {
+      unsigned char byte;
+      std::memcpy(&byte, &value, 1);
+      std::memset(place, byte, n);
+    } else {
+      std::uninitialized_fill_n(place, n, value);
+    }
+  });
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+template<typename InputIterator, typename>
+void Deque<T, Allocator, BacketSize, Statistics>::append(InputIterator first,
+                                             InputIterator last) {
+  using category =
+      typename std::iterator_traits<InputIterator>::iterator_category;
+  if constexpr (!std::is_base_of_v<std::forward_iterator_tag, category>) {
+    for (; first != last; ++first) {
+      emplace_back(*first);
+    }
+  } else {
+    AppendByBackets(std::distance(first, last), [this, &first](T* place,
+                                                               size_t n) {
+      if constexpr (!kPlainConstruct) {
+        ConstructEach(place, n, [this, &first](T* element) {
+          AllocTraits::construct(alloc_, element, *first);
+          ++first;
+        });
+      } else if constexpr (kMemcpyElements &&
+                           (std::is_same_v<InputIterator, iterator> ||
+                            std::is_same_v<InputIterator, const_iterator>)) {
+        // a memcpy for every bucket of the source the chunk touches
+        InputIterator chunk_last = first + static_cast<std::ptrdiff_t>(n);
+        for_each_segment(first, chunk_last, [&place](auto* from, auto* to) {
+          std::memcpy(static_cast<void*>(place), from, (to - from) * sizeof(T));
+          place += to - from;
+          return to;
+        });
+        first = chunk_last;
+      } else if constexpr (std::is_trivially_copyable_v<T> &&
+                    std::contiguous_iterator<InputIterator> &&
+                    std::is_same_v<std::iter_value_t<InputIterator>, T>) {
+        std::memcpy(static_cast<void*>(place), std::to_address(first),
+                    n * sizeof(T));
+        first += n;
+      } else {
+        std::uninitialized_copy_n(first, n, place);
+        std::advance(first, n);
+      }
+    });
+  }
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+void Deque<T, Allocator, BacketSize, Statistics>::assign(size_t count, const T& value) {
+  std::fill(begin(), begin() + std::min(count, size_), value);
+  resize(count, value);
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+template<typename InputIterator, typename>
+void Deque<T, Allocator, BacketSize, Statistics>::assign(InputIterator first,
+                                             InputIterator last) {
+  if constexpr (kMemcpyElements) {
+    // nothing to destroy, the buckets are refilled from the middle, the
+    // front may have been drained past the last bucket
+    if (data_ != nullptr) {
+      Recenter();
+    }
+    size_ = 0;
+    append(first, last);
+    return;
+  }
+  // existing elements and buckets are reused
+  size_t assigned = 0;
+  for (iterator it = begin(); assigned < size_ && first != last;
+       ++it, ++first, ++assigned) {
+    *it = *first;
+  }
+  pop_back(size_ - assigned);
+  append(first, last);
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+void Deque<T, Allocator, BacketSize, Statistics>::assign(std::initializer_list<T> values) {
+  assign(values.begin(), values.end());
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+const T& Deque<T, Allocator, BacketSize, Statistics>::at(size_t pos) const {
   if (pos >= size()) {
     throw std::out_of_range("out_of_range");
   }
   return (*this)[pos];
 }
 
-template<typename T>
-T& Deque<T>::at(size_t pos) {
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+T& Deque<T, Allocator, BacketSize, Statistics>::at(size_t pos) {
   if (pos >= size()) {
     throw std::out_of_range("out_of_range");
   }
   return (*this)[pos];
 }
 
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+T& Deque<T, Allocator, BacketSize, Statistics>::front() {
+  return *Address(0);
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+const T& Deque<T, Allocator, BacketSize, Statistics>::front() const {
+  return *Address(0);
+}
 
-template<typename T>
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+T& Deque<T, Allocator, BacketSize, Statistics>::back() {
+  return *Address(size_ - 1);
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+const T& Deque<T, Allocator, BacketSize, Statistics>::back() const {
+  return *Address(size_ - 1);
+}
+
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
 template<bool is_const>
-Deque<T>::base_iterator<is_const>::base_iterator(T** backet, size_t position)
-  : backet_(backet)
-  , position_in_backet_(position)
-{}
+Deque<T, Allocator, BacketSize, Statistics>::base_iterator<is_const>::base_iterator(
+    T** backet, size_t position) {
+  SetBacket(backet);
+  current_ = first_ + position;
+}
 
-template<typename T>
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+template<bool is_const>
+Deque<T, Allocator, BacketSize, Statistics>::base_iterator<is_const>::base_iterator(
+    T** backet, T* current) {
+  SetBacket(backet);
+  current_ = current;
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
 template<bool is_const>
-typename Deque<T>::template base_iterator<is_const>&
-Deque<T>::base_iterator<is_const>::operator++() {
-  backet_ += (++position_in_backet_) / kBacketSize;
-  position_in_backet_ %= kBacketSize;
+void Deque<T, Allocator, BacketSize, Statistics>::base_iterator<is_const>::SetBacket(
+    T** backet) {
+  backet_ = backet;
+  first_ = *backet;
+  last_ = first_ + kBacketSize;
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+template<bool is_const>
+typename Deque<T, Allocator, BacketSize, Statistics>::template base_iterator<is_const>&
+Deque<T, Allocator, BacketSize, Statistics>::base_iterator<is_const>::operator++() {
+  if (++current_ == last_) {
+    SetBacket(backet_ + 1);
+    current_ = first_;
+  }
   return *this;
 }
 
-template<typename T>
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
 template<bool is_const>
-typename Deque<T>::template base_iterator<is_const>
-Deque<T>::base_iterator<is_const>::operator++(int) {
-  typename Deque<T>::template base_iterator<is_const> temp = *this;
-  backet_ += (++position_in_backet_) / kBacketSize;
-  position_in_backet_ %= kBacketSize;
+typename Deque<T, Allocator, BacketSize, Statistics>::template base_iterator<is_const>
+Deque<T, Allocator, BacketSize, Statistics>::base_iterator<is_const>::operator++(int) {
+  base_iterator temp = *this;
+  ++*this;
   return temp;
 }
 
-template<typename T>
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
 template<bool is_const>
-typename Deque<T>::template base_iterator<is_const>&
-Deque<T>::base_iterator<is_const>::operator--() {
-  if (position_in_backet_ == 0) {
-    position_in_backet_ = kBacketSize;
-    --backet_;    
+typename Deque<T, Allocator, BacketSize, Statistics>::template base_iterator<is_const>&
+Deque<T, Allocator, BacketSize, Statistics>::base_iterator<is_const>::operator--() {
+  if (current_ == first_) {
+    SetBacket(backet_ - 1);
+    current_ = last_;
   }
-  --position_in_backet_;
+  --current_;
   return *this;
 }
 
-template<typename T>
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
 template<bool is_const>
-typename Deque<T>::template base_iterator<is_const>
-Deque<T>::base_iterator<is_const>::operator--(int) {
-  typename Deque<T>::template base_iterator<is_const> temp = *this;
+typename Deque<T, Allocator, BacketSize, Statistics>::template base_iterator<is_const>
+Deque<T, Allocator, BacketSize, Statistics>::base_iterator<is_const>::operator--(int) {
+  base_iterator temp = *this;
   --*this;
   return temp;
 }
 
-template<typename T>
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
 template<bool is_const>
-typename Deque<T>::template base_iterator<is_const>
-Deque<T>::base_iterator<is_const>::operator+(difference_type value) const {
-  Deque<T>::base_iterator<is_const> temp(*this);
+typename Deque<T, Allocator, BacketSize, Statistics>::template base_iterator<is_const>
+Deque<T, Allocator, BacketSize, Statistics>::base_iterator<is_const>::operator+(
+    difference_type value) const {
+  base_iterator temp(*this);
   temp += value;
   return temp;
 }
 
-template<typename T>
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
 template<bool is_const>
-size_t Deque<T>::template base_iterator<is_const>::operator-(
-    typename Deque<T>::template base_iterator<is_const> other) const {
-  size_t result = position_in_backet_ +
-      (backet_ - other.backet_) * kBacketSize - other.position_in_backet_;
-  return result;
+typename Deque<T, Allocator, BacketSize, Statistics>::template base_iterator<is_const>::
+    difference_type
+Deque<T, Allocator, BacketSize, Statistics>::base_iterator<is_const>::operator-(
+    base_iterator other) const {
+  if (backet_ == other.backet_) {
+    return current_ - other.current_;
+  }
+  return (backet_ - other.backet_ - 1) *
+             static_cast<difference_type>(kBacketSize) +
+         (current_ - first_) + (other.last_ - other.current_);
 }
 
-
-template<typename T>
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
 template<bool is_const>
-bool Deque<T>::template base_iterator<is_const>::operator==(
-    typename Deque<T>::template base_iterator<is_const> other) const {
-  return backet_ == other.backet_ && 
-         position_in_backet_ == other.position_in_backet_;
+typename Deque<T, Allocator, BacketSize, Statistics>::template base_iterator<is_const>::
+    reference
+Deque<T, Allocator, BacketSize, Statistics>::base_iterator<is_const>::operator[](
+    difference_type value) const {
+  return *(*this + value);
 }
 
+// The slot after the last bucket of the map repeats the first one, so
+// the element pointer alone doesn't tell end() from the start of the map.
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+template<bool is_const>
+bool Deque<T, Allocator, BacketSize, Statistics>::base_iterator<is_const>::operator==(
+    base_iterator other) const {
+  return current_ == other.current_ && backet_ == other.backet_;
+}
 
-template<typename T>
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
 template<bool is_const>
-bool Deque<T>::base_iterator<is_const>::operator!=(
-    typename Deque<T>::template base_iterator<is_const> other) const { 
+bool Deque<T, Allocator, BacketSize, Statistics>::base_iterator<is_const>::operator!=(
+    base_iterator other) const { 
   return !(*this == other); 
 }
 
-template<typename T>
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
 template<bool is_const>
-bool Deque<T>::base_iterator<is_const>::operator>(
-    typename Deque<T>::template base_iterator<is_const> other) const { 
-
-  if (backet_ < other.backet_) { return false; }
-  if (backet_ == other.backet_ && 
-      position_in_backet_ <= other.position_in_backet_) { return false; }
-  return true;
+bool Deque<T, Allocator, BacketSize, Statistics>::base_iterator<is_const>::operator>(
+    base_iterator other) const { 
+  return *this - other > 0;
 }
 
-template<typename T>
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
 template<bool is_const>
-bool Deque<T>::base_iterator<is_const>::operator<(
-    typename Deque<T>::template base_iterator<is_const> other) const { 
+bool Deque<T, Allocator, BacketSize, Statistics>::base_iterator<is_const>::operator<(
+    base_iterator other) const { 
   return other > *this; 
 }
 
-template<typename T>
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
 template<bool is_const>
-bool Deque<T>::base_iterator<is_const>::operator>=(
-    typename Deque<T>::template base_iterator<is_const> other) const { 
+bool Deque<T, Allocator, BacketSize, Statistics>::base_iterator<is_const>::operator>=(
+    base_iterator other) const { 
   return !(*this < other); 
 }
 
-template<typename T>
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
 template<bool is_const>
-bool Deque<T>::base_iterator<is_const>::operator<=(
-    typename Deque<T>::template base_iterator<is_const> other) const { 
+bool Deque<T, Allocator, BacketSize, Statistics>::base_iterator<is_const>::operator<=(
+    base_iterator other) const { 
   return !(*this > other); 
 }
 
-template<typename T>
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
 template<bool is_const>
-typename Deque<T>::template base_iterator<is_const>& 
-Deque<T>::template base_iterator<is_const>::operator+=(size_t value) {
-  backet_ += (position_in_backet_ + value) / Deque<T>::kBacketSize;
-  position_in_backet_ = (position_in_backet_ + value) % Deque<T>::kBacketSize; 
+typename Deque<T, Allocator, BacketSize, Statistics>::template base_iterator<is_const>& 
+Deque<T, Allocator, BacketSize, Statistics>::base_iterator<is_const>::operator+=(
+    difference_type value) {
+  difference_type offset = (current_ - first_) + value;
+  if (offset >= 0 && offset < static_cast<difference_type>(kBacketSize)) {
+    current_ += value;
+    return *this;
+  }
+  // unsigned division, a shift for the usual power of two sizes
+  if (offset >= 0) {
+    size_t forward = static_cast<size_t>(offset);
+    SetBacket(backet_ + forward / kBacketSize);
+    current_ = first_ + forward % kBacketSize;
+  } else {
+    size_t backward = static_cast<size_t>(-offset - 1);
+    SetBacket(backet_ - (backward / kBacketSize + 1));
+    current_ = first_ + (kBacketSize - 1 - backward % kBacketSize);
+  }
   return *this;
 }
 
-template<typename T>
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
 template<bool is_const>
-typename Deque<T>::template base_iterator<is_const>& 
-Deque<T>::base_iterator<is_const>::operator-=(size_t value) {
-  if (position_in_backet_ >= value) {
-    position_in_backet_ -= value;
-    return *this;
-  }
-  backet_ -= 
-      (value - position_in_backet_ + kBacketSize - 1) / kBacketSize;
-  position_in_backet_ = 
-      (kBacketSize - (value - position_in_backet_) % kBacketSize) % kBacketSize; 
-  return *this;
+typename Deque<T, Allocator, BacketSize, Statistics>::template base_iterator<is_const>& 
+Deque<T, Allocator, BacketSize, Statistics>::base_iterator<is_const>::operator-=(
+    difference_type value) {
+  return *this += -value;
 }
 
-template<typename T>
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
 template<bool is_const>
-typename Deque<T>::template base_iterator<is_const>
-Deque<T>::base_iterator<is_const>::operator-(difference_type value) const {
-  typename Deque<T>::template base_iterator<is_const> temp = *this;
+typename Deque<T, Allocator, BacketSize, Statistics>::template base_iterator<is_const>
+Deque<T, Allocator, BacketSize, Statistics>::base_iterator<is_const>::operator-(
+    difference_type value) const {
+  base_iterator temp = *this;
   return temp -= value;
 }
 
-template<typename T>
-typename Deque<T>::iterator
-Deque<T>::begin() {
-  return Deque<T>::iterator(data_ + first_used_backet_, first_used_index_);
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+typename Deque<T, Allocator, BacketSize, Statistics>::iterator
+Deque<T, Allocator, BacketSize, Statistics>::begin() {
+  if (data_ == nullptr) {
+    return iterator(EmptyMap() + 1, kBacketSize / 2);
+  }
+  // a full first bucket is kept as index kBacketSize, iterators use the
+  // start of the next one like end() does
+  if (first_used_index_ == kBacketSize) {
+    return iterator(data_ + first_used_backet_ + 1, size_t(0));
+  }
+  return iterator(data_ + first_used_backet_, first_used_index_);
 }
 
-template<typename T>
-typename Deque<T>::iterator
-Deque<T>::end() {
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+typename Deque<T, Allocator, BacketSize, Statistics>::iterator
+Deque<T, Allocator, BacketSize, Statistics>::end() {
+  if (data_ == nullptr) {
+    return iterator(EmptyMap() + 1, kBacketSize / 2);
+  }
   size_t current_index = last_non_used_index_;
   T** current_backet = data_ + last_used_backet_;
   if (last_non_used_index_ == kBacketSize) {
     current_index = 0;
     ++current_backet;
   }
-  return Deque<T>::iterator(current_backet, current_index);
+  return iterator(current_backet, current_index);
 }
 
-template<typename T>
-typename Deque<T>::const_iterator
-Deque<T>::begin() const {
-  return const_iterator(data_ + first_used_backet_, first_used_index_);
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+typename Deque<T, Allocator, BacketSize, Statistics>::const_iterator
+Deque<T, Allocator, BacketSize, Statistics>::begin() const {
+  return const_cast<Deque<T, Allocator, BacketSize, Statistics>*>(this)->begin();
 }
 
-template<typename T>
-typename Deque<T>::const_iterator
-Deque<T>::cbegin() const {
-  return const_iterator(data_ + first_used_backet_, first_used_index_);
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+typename Deque<T, Allocator, BacketSize, Statistics>::const_iterator
+Deque<T, Allocator, BacketSize, Statistics>::cbegin() const {
+  return begin();
 }
 
-template<typename T>
-typename Deque<T>::const_iterator
-Deque<T>::end() const {
-  return const_iterator(data_ + last_used_backet_, last_non_used_index_);
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+typename Deque<T, Allocator, BacketSize, Statistics>::const_iterator
+Deque<T, Allocator, BacketSize, Statistics>::end() const {
+  return const_cast<Deque<T, Allocator, BacketSize, Statistics>*>(this)->end();
 }
 
-template<typename T>
-typename Deque<T>::const_iterator
-Deque<T>::cend() const {
-  return const_iterator(data_ + last_used_backet_, last_non_used_index_);
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+typename Deque<T, Allocator, BacketSize, Statistics>::const_iterator
+Deque<T, Allocator, BacketSize, Statistics>::cend() const {
+  return end();
 }
 
-template<typename T>
-void Deque<T>::insert(iterator it, const T& value) {
-  T temp = value;
-  for (; it != end(); ++it) {
-    std::swap(temp, *it);
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+typename Deque<T, Allocator, BacketSize, Statistics>::segments_type
+Deque<T, Allocator, BacketSize, Statistics>::segments() {
+  if (size_ == 0) {
+    return segments_type(nullptr, 0, nullptr, 0);
+  }
+  T** first = data_ + first_used_backet_;
+  size_t first_index = first_used_index_;
+  if (first_index == kBacketSize) {
+    ++first;
+    first_index = 0;
+  }
+  T** last = data_ + last_used_backet_ + 1;
+  size_t last_index = last_non_used_index_;
+  if (last_index == 0) {
+    --last;
+    last_index = kBacketSize;
   }
-  push_back(temp);
+  return segments_type(first, first_index, last, last_index);
 }
 
-template<typename T>
-void Deque<T>::erase(iterator it) {
-  for (; it != end() - 1; ++it) {
-    std::swap(*it, *(it + 1));
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+typename Deque<T, Allocator, BacketSize, Statistics>::const_segments_type
+Deque<T, Allocator, BacketSize, Statistics>::segments() const {
+  segments_type result = const_cast<Deque<T, Allocator, BacketSize, Statistics>*>(this)
+      ->segments();
+  return const_segments_type(result.first_, result.first_index_,
+                             result.last_, result.last_index_);
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+template<bool is_const, typename Visit>
+typename Deque<T, Allocator, BacketSize, Statistics>::template base_iterator<is_const>
+Deque<T, Allocator, BacketSize, Statistics>::for_each_segment(
+    base_iterator<is_const> first, base_iterator<is_const> last,
+    Visit visit) {
+  using pointer = typename base_iterator<is_const>::pointer;
+  T** backet = first.backet_;
+  T* span_first = first.current_;
+  for (; backet != last.backet_; ++backet, span_first = *backet) {
+    T* span_last = *backet + kBacketSize;
+    pointer stop = visit(pointer(span_first), pointer(span_last));
+    if (stop != span_last) {
+      return base_iterator<is_const>(backet, const_cast<T*>(stop));
+    }
+  }
+  if (span_first == last.current_) {
+    return last;
+  }
+  pointer stop = visit(pointer(span_first), pointer(last.current_));
+  return base_iterator<is_const>(backet, const_cast<T*>(stop));
+}
+
+// Iterators of a deque without a map point into the middle slot of this
+// one, so they can be stepped over the ends like those of a deque that
+// has a map. The bucket is never read or written.
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+T** Deque<T, Allocator, BacketSize, Statistics>::EmptyMap() {
+  alignas(T) static unsigned char backet[sizeof(T) * kBacketSize];
+  static T* map[3] = {reinterpret_cast<T*>(backet),
+                      reinterpret_cast<T*>(backet),
+                      reinterpret_cast<T*>(backet)};
+  return map;
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+T* Deque<T, Allocator, BacketSize, Statistics>::Address(size_t pos) const {
+  size_t global = first_used_index_ + pos;
+  return data_[first_used_backet_ + global / kBacketSize] +
+         global % kBacketSize;
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+size_t Deque<T, Allocator, BacketSize, Statistics>::IndexInBacket(size_t pos) const {
+  return (first_used_index_ + pos) % kBacketSize;
+}
+
+// Moves count constructed elements from position from to position to,
+// ranges may overlap. Works by contiguous spans inside buckets.
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+void Deque<T, Allocator, BacketSize, Statistics>::MoveElements(size_t from, size_t to,
+                                                   size_t count) {
+  if (count == 0 || from == to) {
+    return;
+  }
+  if (to < from) {
+    while (count != 0) {
+      size_t chunk = std::min({count, kBacketSize - IndexInBacket(from),
+                               kBacketSize - IndexInBacket(to)});
+      T* source = Address(from);
+      T* destination = Address(to);
+      if constexpr (std::is_trivially_copyable_v<T>) {
+        std::memmove(static_cast<void*>(destination), source,
+                     chunk * sizeof(T));
+      } else {
+        std::move(source, source + chunk, destination);
+      }
+      from += chunk;
+      to += chunk;
+      count -= chunk;
+    }
+  } else {
+    while (count != 0) {
+      size_t chunk = std::min({count, IndexInBacket(from + count - 1) + 1,
+                               IndexInBacket(to + count - 1) + 1});
+      count -= chunk;
+      T* source = Address(from + count);
+      T* destination = Address(to + count);
+      if constexpr (std::is_trivially_copyable_v<T>) {
+        std::memmove(static_cast<void*>(destination), source,
+                     chunk * sizeof(T));
+      } else {
+        std::move_backward(source, source + chunk, destination + chunk);
+      }
+    }
+  }
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+typename Deque<T, Allocator, BacketSize, Statistics>::iterator
+Deque<T, Allocator, BacketSize, Statistics>::insert(iterator it, const T& value) {
+  return insert(it, T(value));
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+typename Deque<T, Allocator, BacketSize, Statistics>::iterator
+Deque<T, Allocator, BacketSize, Statistics>::insert(iterator it, T&& value) {
+  size_t pos = it - begin();
+  if (pos == 0) {
+    emplace_front(std::move(value));
+    return begin();
+  }
+  if (pos == size_) {
+    emplace_back(std::move(value));
+    return begin() + pos;
+  }
+  // value may be an element of this deque
+  T temp = std::move(value);
+  if (pos < size_ - pos) {
+    emplace_front(std::move(*Address(0)));
+    MoveElements(2, 1, pos - 1);
+  } else {
+    emplace_back(std::move(*Address(size_ - 1)));
+    MoveElements(pos, pos + 1, size_ - pos - 2);
   }
-  pop_back();
+  *Address(pos) = std::move(temp);
+  return begin() + pos;
 }
 
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+template<typename InputIterator>
+typename Deque<T, Allocator, BacketSize, Statistics>::iterator
+Deque<T, Allocator, BacketSize, Statistics>::insert(iterator it, InputIterator first,
+                                        InputIterator last) {
+  using category =
+      typename std::iterator_traits<InputIterator>::iterator_category;
+  size_t pos = it - begin();
+  if constexpr (!std::is_base_of_v<std::forward_iterator_tag, category>) {
+    Deque<T, Allocator, BacketSize, Statistics> values(alloc_);
+    for (; first != last; ++first) {
+      values.emplace_back(*first);
+    }
+    return insert(begin() + pos, std::make_move_iterator(values.begin()),
+                  std::make_move_iterator(values.end()));
+  } else {
+    size_t count = std::distance(first, last);
+    size_t old_size = size_;
+    if (count == 0) {
+      return begin() + pos;
+    }
+    if (pos < old_size - pos) {
+      if (pos >= count) {
+        // the first count elements go to new slots in front
+        for (size_t i = 0; i < count; ++i) {
+          emplace_front(std::move(*Address(count - 1)));
+        }
+        MoveElements(2 * count, count, pos - count);
+        std::copy(first, last, begin() + pos);
+      } else {
+        // new slots get the whole head and a part of the values
+        size_t outside = count - pos;
+        InputIterator middle = std::next(first, outside);
+        try {
+          for (InputIterator value = first; value != middle; ++value) {
+            emplace_front(*value);
+          }
+        } catch (...) {
+          pop_front(size_ - old_size);
+          throw;
+        }
+        std::reverse(begin(), begin() + outside);
+        for (size_t i = 0; i < pos; ++i) {
+          emplace_front(std::move(*Address(outside + pos - 1)));
+        }
+        std::copy(middle, last, begin() + count);
+      }
+    } else {
+      size_t tail = old_size - pos;
+      if (tail >= count) {
+        for (size_t i = old_size - count; i < old_size; ++i) {
+          emplace_back(std::move(*Address(i)));
+        }
+        MoveElements(pos, pos + count, tail - count);
+        std::copy(first, last, begin() + pos);
+      } else {
+        InputIterator middle = std::next(first, tail);
+        try {
+          for (InputIterator value = middle; value != last; ++value) {
+            emplace_back(*value);
+          }
+        } catch (...) {
+          pop_back(size_ - old_size);
+          throw;
+        }
+        for (size_t i = pos; i < old_size; ++i) {
+          emplace_back(std::move(*Address(i)));
+        }
+        std::copy(first, middle, begin() + pos);
+      }
+    }
+    return begin() + pos;
+  }
+}
 
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+typename Deque<T, Allocator, BacketSize, Statistics>::iterator
+Deque<T, Allocator, BacketSize, Statistics>::erase(iterator it) {
+  return erase(it, it + 1);
+}
+
+template<typename T, typename Allocator, size_t BacketSize, typename Statistics>
+typename Deque<T, Allocator, BacketSize, Statistics>::iterator
+Deque<T, Allocator, BacketSize, Statistics>::erase(iterator first, iterator last) {
+  size_t pos = first - begin();
+  size_t count = last - first;
+  if (pos < size_ - pos - count) {
+    MoveElements(0, count, pos);
+    pop_front(count);
+  } else {
+    MoveElements(pos + count, pos, size_ - pos - count);
+    pop_back(count);
+  }
+  return begin() + pos;
+}
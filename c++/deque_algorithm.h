@@ -0,0 +1,158 @@
+#pragma once
+#include "deque.h"
+
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+#include <type_traits>
+#include <utility>
+
+// Algorithms that know a Deque is a sequence of contiguous buckets.
+// For Deque iterators they run a plain loop over every bucket instead of
+// stepping the iterator element by element, other iterators are passed
+// to the std algorithm of the same name.
+namespace segmented {
+
+template<typename Iterator>
+concept DequeIterator =
+    requires { typename Iterator::container_type; } &&
+    (std::is_same_v<Iterator, typename Iterator::container_type::iterator> ||
+     std::is_same_v<Iterator,
+                    typename Iterator::container_type::const_iterator>);
+
+template<typename Iterator, typename Visit>
+Iterator ForEachSegment(Iterator first, Iterator last, Visit visit) {
+  return Iterator::container_type::for_each_segment(first, last, visit);
+}
+
+// Copies [first, last) of contiguous memory to out, returns the end of
+// the written range
+template<typename T, typename OutputIterator>
+OutputIterator CopySpan(const T* first, const T* last, OutputIterator out) {
+  if constexpr (DequeIterator<OutputIterator>) {
+    OutputIterator out_last = out + (last - first);
+    ForEachSegment(out, out_last, [&first](auto* span_first, auto* span_last) {
+      auto count = span_last - span_first;
+      std::copy(first, first + count, span_first);
+      first += count;
+      return span_last;
+    });
+    return out_last;
+  } else {
+    return std::copy(first, last, out);
+  }
+}
+
+template<typename InputIterator, typename Function>
+Function for_each(InputIterator first, InputIterator last, Function function) {
+  if constexpr (DequeIterator<InputIterator>) {
+    ForEachSegment(first, last, [&function](auto* span_first, auto* span_last) {
+      for (; span_first != span_last; ++span_first) {
+        function(*span_first);
+      }
+      return span_last;
+    });
+    return function;
+  } else {
+    return std::for_each(first, last, std::move(function));
+  }
+}
+
+template<typename InputIterator, typename OutputIterator>
+OutputIterator copy(InputIterator first, InputIterator last,
+                    OutputIterator out) {
+  if constexpr (DequeIterator<InputIterator>) {
+    ForEachSegment(first, last, [&out](auto* span_first, auto* span_last) {
+      out = CopySpan(span_first, span_last, out);
+      return span_last;
+    });
+    return out;
+  } else if constexpr (DequeIterator<OutputIterator> &&
+                       std::random_access_iterator<InputIterator>) {
+    OutputIterator out_last = out + (last - first);
+    ForEachSegment(out, out_last, [&first](auto* span_first, auto* span_last) {
+      auto count = span_last - span_first;
+      std::copy(first, first + count, span_first);
+      first += count;
+      return span_last;
+    });
+    return out_last;
+  } else {
+    return std::copy(first, last, out);
+  }
+}
+
+template<typename ForwardIterator, typename T>
+void fill(ForwardIterator first, ForwardIterator last, const T& value) {
+  if constexpr (DequeIterator<ForwardIterator>) {
+    ForEachSegment(first, last, [&value](auto* span_first, auto* span_last) {
+      std::fill(span_first, span_last, value);
+      return span_last;
+    });
+  } else {
+    std::fill(first, last, value);
+  }
+}
+
+template<typename InputIterator, typename T>
+InputIterator find(InputIterator first, InputIterator last, const T& value) {
+  if constexpr (DequeIterator<InputIterator>) {
+    return ForEachSegment(first, last,
+                          [&value](auto* span_first, auto* span_last) {
+      return std::find(span_first, span_last, value);
+    });
+  } else {
+    return std::find(first, last, value);
+  }
+}
+
+template<typename InputIterator, typename Predicate>
+InputIterator find_if(InputIterator first, InputIterator last,
+                      Predicate predicate) {
+  if constexpr (DequeIterator<InputIterator>) {
+    return ForEachSegment(first, last,
+                          [&predicate](auto* span_first, auto* span_last) {
+      return std::find_if(span_first, span_last, predicate);
+    });
+  } else {
+    return std::find_if(first, last, std::move(predicate));
+  }
+}
+
+template<typename InputIterator, typename T>
+size_t count(InputIterator first, InputIterator last, const T& value) {
+  if constexpr (DequeIterator<InputIterator>) {
+    size_t result = 0;
+    ForEachSegment(first, last,
+                   [&value, &result](auto* span_first, auto* span_last) {
+      result += std::count(span_first, span_last, value);
+      return span_last;
+    });
+    return result;
+  } else {
+    return std::count(first, last, value);
+  }
+}
+
+template<typename InputIterator, typename T, typename BinaryOperation>
+T accumulate(InputIterator first, InputIterator last, T init,
+             BinaryOperation operation) {
+  if constexpr (DequeIterator<InputIterator>) {
+    ForEachSegment(first, last,
+                   [&init, &operation](auto* span_first, auto* span_last) {
+      init = std::accumulate(span_first, span_last, std::move(init),
+                             operation);
+      return span_last;
+    });
+    return init;
+  } else {
+    return std::accumulate(first, last, std::move(init), std::move(operation));
+  }
+}
+
+template<typename InputIterator, typename T>
+T accumulate(InputIterator first, InputIterator last, T init) {
+  return segmented::accumulate(first, last, std::move(init), std::plus<>());
+}
+
+}  // namespace segmented
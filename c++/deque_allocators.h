@@ -0,0 +1,233 @@
+#pragma once
+#include "deque.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <sys/mman.h>
+
+// Allocators for Deque buckets. Deque allocates a bucket with a single
+// allocate(BacketSize) call, so where an allocator puts its blocks is
+// where the buckets start.
+
+// Blocks start at a multiple of Alignment, a cache line by default, so a
+// bucket of whole cache lines never shares one with another allocation
+// and vector loads over it can be aligned ones.
+template<typename T, size_t Alignment = kCacheLineSize>
+class AlignedAllocator {
+  static_assert((Alignment & (Alignment - 1)) == 0,
+                "alignment has to be a power of two");
+
+ public:
+  using value_type = T;
+  using is_always_equal = std::true_type;
+
+  template<typename U>
+  struct rebind {
+    using other = AlignedAllocator<U, Alignment>;
+  };
+
+  AlignedAllocator() = default;
+  template<typename U>
+  AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+  T* allocate(size_t count) {
+    return static_cast<T*>(::operator new(count * sizeof(T), kAlignment));
+  }
+  void deallocate(T* pointer, size_t count) {
+    ::operator delete(pointer, count * sizeof(T), kAlignment);
+  }
+
+  template<typename U>
+  bool operator==(const AlignedAllocator<U, Alignment>&) const {
+    return true;
+  }
+
+ private:
+  static constexpr std::align_val_t kAlignment{
+      std::max(Alignment, alignof(T))};
+};
+
+// Bytes in one huge page on x86-64 and the unit HugePageArena maps.
+inline constexpr size_t kHugePageBytes = size_t(2) << 20;
+
+// Memory mapped in kHugePageBytes aligned regions that the kernel is
+// asked with madvise(MADV_HUGEPAGE) to back with huge pages, so a large
+// deque spreads over a few TLB entries instead of one per 4 KiB page.
+// Blocks are carved from the current region in cache line steps. A freed
+// block is kept for the next request of the same size, Deque buckets all
+// have one size, so they are recycled. Blocks larger than half a region
+// get regions of their own, which are unmapped when freed. Everything
+// else is unmapped with the arena. Thread safe, one arena is shared by
+// all default constructed HugePageAllocators. A lock per bucket is cheap
+// next to the element operations filling it.
+class HugePageArena {
+ public:
+  HugePageArena() = default;
+  HugePageArena(const HugePageArena&) = delete;
+  HugePageArena& operator=(const HugePageArena&) = delete;
+  ~HugePageArena();
+
+  void* Allocate(size_t bytes);
+  void Deallocate(void* block, size_t bytes);
+
+  // bytes mapped so far, for tests and benchmarks
+  size_t mapped_bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return mapped_bytes_;
+  }
+
+ private:
+  static constexpr size_t kLargeBlockBytes = kHugePageBytes / 2;
+
+  static size_t RoundUp(size_t bytes, size_t unit) {
+    return (bytes + unit - 1) / unit * unit;
+  }
+  void* MapRegion(size_t bytes);
+  void UnmapRegion(void* region, size_t bytes);
+
+  // Blocks of one rounded size. free has room for every carved block, so
+  // Deallocate never allocates.
+  struct SizeClass {
+    std::vector<void*> free;
+    size_t carved = 0;
+  };
+
+  mutable std::mutex mutex_;
+  std::vector<char*> regions_;                 // kHugePageBytes each
+  char* next_ = nullptr;                      // in the last region
+  char* end_ = nullptr;
+  std::map<size_t, SizeClass> size_classes_;
+  size_t mapped_bytes_ = 0;
+};
+
+inline HugePageArena::~HugePageArena() {
+  for (char* region : regions_) {
+    UnmapRegion(region, kHugePageBytes);
+  }
+}
+
+// Maps bytes, a multiple of kHugePageBytes, at a kHugePageBytes aligned
+// address: a huge page has to be aligned to its size, mmap only aligns to
+// 4 KiB, so one page more is mapped and the ends are cut off.
+inline void* HugePageArena::MapRegion(size_t bytes) {
+  size_t mapped = bytes + kHugePageBytes;
+  void* raw = ::mmap(nullptr, mapped, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (raw == MAP_FAILED) {
+    throw std::bad_alloc();
+  }
+  char* start = static_cast<char*>(raw);
+  char* aligned = reinterpret_cast<char*>(
+      RoundUp(reinterpret_cast<uintptr_t>(start), kHugePageBytes));
+  if (aligned != start) {
+    ::munmap(start, static_cast<size_t>(aligned - start));
+  }
+  size_t tail = static_cast<size_t>(start + mapped - (aligned + bytes));
+  if (tail != 0) {
+    ::munmap(aligned + bytes, tail);
+  }
+  // only a hint, the region works with small pages as well
+  ::madvise(aligned, bytes, MADV_HUGEPAGE);
+  mapped_bytes_ += bytes;
+  return aligned;
+}
+
+inline void HugePageArena::UnmapRegion(void* region, size_t bytes) {
+  ::munmap(region, bytes);
+  mapped_bytes_ -= bytes;
+}
+
+inline void* HugePageArena::Allocate(size_t bytes) {
+  bytes = RoundUp(std::max<size_t>(bytes, 1), kCacheLineSize);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (bytes > kLargeBlockBytes) {
+    return MapRegion(RoundUp(bytes, kHugePageBytes));
+  }
+  SizeClass& size_class = size_classes_[bytes];
+  if (!size_class.free.empty()) {
+    void* block = size_class.free.back();
+    size_class.free.pop_back();
+    return block;
+  }
+  size_class.free.reserve(size_class.carved + 1);
+  if (static_cast<size_t>(end_ - next_) < bytes) {
+    // the rest of the current region is left unused
+    regions_.reserve(regions_.size() + 1);
+    next_ = static_cast<char*>(MapRegion(kHugePageBytes));
+    end_ = next_ + kHugePageBytes;
+    regions_.push_back(next_);
+  }
+  void* block = next_;
+  next_ += bytes;
+  ++size_class.carved;
+  return block;
+}
+
+inline void HugePageArena::Deallocate(void* block, size_t bytes) {
+  bytes = RoundUp(std::max<size_t>(bytes, 1), kCacheLineSize);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (bytes > kLargeBlockBytes) {
+    UnmapRegion(block, RoundUp(bytes, kHugePageBytes));
+    return;
+  }
+  size_classes_.find(bytes)->second.free.push_back(block);
+}
+
+// The arena of default constructed HugePageAllocators, so that deques
+// made with them share their regions instead of mapping 2 MiB each.
+inline const std::shared_ptr<HugePageArena>& DefaultHugePageArena() {
+  static const std::shared_ptr<HugePageArena> arena =
+      std::make_shared<HugePageArena>();
+  return arena;
+}
+
+// Allocator over a HugePageArena. Copies and rebound copies share the
+// arena of the allocator they came from, a default constructed one uses
+// DefaultHugePageArena(). An arena is unmapped once no allocator refers
+// to it.
+template<typename T>
+class HugePageAllocator {
+  static_assert(alignof(T) <= kCacheLineSize,
+                "blocks are aligned to cache lines only");
+
+ public:
+  using value_type = T;
+  using propagate_on_container_copy_assignment = std::true_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+
+  HugePageAllocator(): arena_(DefaultHugePageArena()) {}
+  explicit HugePageAllocator(std::shared_ptr<HugePageArena> arena)
+    : arena_(std::move(arena))
+  {}
+  template<typename U>
+  HugePageAllocator(const HugePageAllocator<U>& other)
+    : arena_(other.arena())
+  {}
+
+  T* allocate(size_t count) {
+    return static_cast<T*>(arena_->Allocate(count * sizeof(T)));
+  }
+  void deallocate(T* pointer, size_t count) {
+    arena_->Deallocate(pointer, count * sizeof(T));
+  }
+
+  const std::shared_ptr<HugePageArena>& arena() const { return arena_; }
+
+  template<typename U>
+  bool operator==(const HugePageAllocator<U>& other) const {
+    return arena_ == other.arena();
+  }
+
+ private:
+  std::shared_ptr<HugePageArena> arena_;
+};
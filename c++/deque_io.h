@@ -0,0 +1,186 @@
+#pragma once
+#include "deque.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// Scatter/gather I/O for deques: the buckets are handed to the kernel as
+// they are, nothing is copied into a flat buffer first.
+
+// iovecs passed to one writev call by WriteDeque, well below IOV_MAX
+inline constexpr size_t kDequeWriteIovecs = 64;
+
+// iovecs passed to one readv or writev call by SaveDeque and LoadDeque,
+// IOV_MAX on Linux
+inline constexpr size_t kDequeFileIovecs = 1024;
+
+// What SaveDeque writes before the elements, in the byte order of the
+// machine.
+struct DequeFileHeader {
+  uint64_t magic;
+  uint64_t element_size;
+  uint64_t size;
+};
+
+inline constexpr uint64_t kDequeFileMagic = 0x6c69466575716544;  // "DequeFil"
+
+// Describes the front of d with at most count iovecs, one per bucket.
+// Returns the number of iovecs filled.
+template<typename Allocator, size_t BacketSize, typename Statistics>
+size_t FillIovec(const Deque<char, Allocator, BacketSize, Statistics>& d,
+                 iovec* iov, size_t count) {
+  size_t filled = 0;
+  for (std::span<const char> segment : d.segments()) {
+    if (filled == count) {
+      break;
+    }
+    iov[filled].iov_base = const_cast<char*>(segment.data());
+    iov[filled].iov_len = segment.size();
+    ++filled;
+  }
+  return filled;
+}
+
+template<typename Allocator, size_t BacketSize, typename Statistics>
+std::vector<iovec> MakeIovec(
+    const Deque<char, Allocator, BacketSize, Statistics>& d) {
+  std::vector<iovec> result(d.segments().size());
+  FillIovec(d, result.data(), result.size());
+  return result;
+}
+
+// Writes the front of d to fd with a single writev and removes the
+// written bytes from d. Returns what writev returned.
+template<typename Allocator, size_t BacketSize, typename Statistics>
+ssize_t WriteDeque(int fd, Deque<char, Allocator, BacketSize, Statistics>& d) {
+  iovec iov[kDequeWriteIovecs];
+  size_t filled = FillIovec(d, iov, kDequeWriteIovecs);
+  if (filled == 0) {
+    return 0;
+  }
+  ssize_t written = writev(fd, iov, static_cast<int>(filled));
+  if (written > 0) {
+    d.pop_front(static_cast<size_t>(written));
+  }
+  return written;
+}
+
+// Calls transfer, readv or writev on fd, until all of iov[0, count) is
+// done, moving iov past what every call managed.
+template<typename Transfer>
+void TransferIovec(int fd, iovec* iov, size_t count, Transfer transfer) {
+  while (count != 0) {
+    ssize_t done = transfer(fd, iov, static_cast<int>(count));
+    if (done < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::system_error(errno, std::generic_category(), "deque file");
+    }
+    if (done == 0) {
+      throw std::runtime_error("deque file is truncated");
+    }
+    size_t left = static_cast<size_t>(done);
+    while (count != 0 && left >= iov->iov_len) {
+      left -= iov->iov_len;
+      ++iov;
+      --count;
+    }
+    if (left != 0) {
+      iov->iov_base = static_cast<char*>(iov->iov_base) + left;
+      iov->iov_len -= left;
+    }
+  }
+}
+
+// Hands segments to transfer, after whatever iov already holds, up to
+// kDequeFileIovecs iovecs at a time.
+template<typename Segments, typename Transfer>
+void TransferSegments(int fd, Segments segments, std::vector<iovec>& iov,
+                      Transfer transfer) {
+  for (auto segment : segments) {
+    if (iov.size() == kDequeFileIovecs) {
+      TransferIovec(fd, iov.data(), iov.size(), transfer);
+      iov.clear();
+    }
+    iov.push_back({const_cast<void*>(static_cast<const void*>(segment.data())),
+                   segment.size_bytes()});
+  }
+  TransferIovec(fd, iov.data(), iov.size(), transfer);
+}
+
+// Writes d to fd as a DequeFileHeader followed by the bytes of the
+// elements, a bucket per iovec. Throws std::system_error if a write fails.
+template<typename T, typename Allocator, size_t BacketSize,
+         typename Statistics>
+void SaveDeque(int fd, const Deque<T, Allocator, BacketSize, Statistics>& d) {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "elements are saved as bytes");
+  DequeFileHeader header{kDequeFileMagic, sizeof(T), d.size()};
+  std::vector<iovec> iov;
+  iov.reserve(kDequeFileIovecs);
+  iov.push_back({&header, sizeof(header)});
+  TransferSegments(fd, d.segments(), iov, ::writev);
+}
+
+// Replaces the elements of d with ones SaveDeque wrote to fd. The buckets
+// are allocated first and read into, so every byte is copied once, by the
+// kernel. The size in the header isn't trusted: for a regular file it is
+// checked against the bytes left, other files are read a readv worth of
+// buckets at a time, so a bad header can't make it allocate more than
+// was read. Throws std::runtime_error if fd doesn't hold a deque of T and
+// std::system_error if a read fails, d is left as it was then.
+template<typename T, typename Allocator, size_t BacketSize,
+         typename Statistics>
+void LoadDeque(int fd, Deque<T, Allocator, BacketSize, Statistics>& d) {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "elements are loaded as bytes");
+  DequeFileHeader header;
+  iovec head{&header, sizeof(header)};
+  TransferIovec(fd, &head, 1, ::readv);
+  if (header.magic != kDequeFileMagic) {
+    throw std::runtime_error("not a deque file");
+  }
+  if (header.element_size != sizeof(T)) {
+    throw std::runtime_error("deque file holds another element type");
+  }
+  struct stat status;
+  if (::fstat(fd, &status) == 0 && S_ISREG(status.st_mode)) {
+    off_t position = ::lseek(fd, 0, SEEK_CUR);
+    if (position >= 0 && header.size >
+        static_cast<uint64_t>(status.st_size - position) / sizeof(T)) {
+      throw std::runtime_error("deque file is truncated");
+    }
+  }
+  using Loaded = Deque<T, Allocator, BacketSize, Statistics>;
+  // a chunk not starting at a bucket start still fits in one readv
+  constexpr size_t kChunk = (kDequeFileIovecs - 1) * BacketSize;
+  Loaded loaded(d.get_allocator());
+  std::vector<iovec> iov;
+  iov.reserve(kDequeFileIovecs);
+  while (loaded.size() < header.size) {
+    size_t from = loaded.size();
+    loaded.resize_for_overwrite(
+        from + static_cast<size_t>(std::min<uint64_t>(header.size - from,
+                                                      kChunk)));
+    Loaded::for_each_segment(loaded.begin() + from, loaded.end(),
+                             [&iov](T* first, T* last) {
+      iov.push_back({first, (last - first) * sizeof(T)});
+      return last;
+    });
+    TransferIovec(fd, iov.data(), iov.size(), ::readv);
+    iov.clear();
+  }
+  d = std::move(loaded);
+}
@@ -0,0 +1,172 @@
+#pragma once
+#include "deque.h"
+#include "deque_algorithm.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <latch>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// Parallel versions of the segmented algorithms. The pool plays the part
+// of an execution policy: [first, last) is cut on bucket boundaries into
+// a few chunks per worker, the calling thread runs the first chunk and
+// waits for the rest. Can't be called from a task of the same pool.
+namespace segmented {
+
+// chunks per worker, evens out workers that got a slower piece
+inline constexpr size_t kParallelChunksPerWorker = 4;
+
+template<typename Pointer>
+struct Segment {
+  Pointer first;
+  Pointer last;
+  size_t offset;          // elements before it in the whole range
+};
+
+// Chunk i is segments [bounds[i], bounds[i + 1]).
+template<typename Pointer>
+struct Chunks {
+  std::vector<Segment<Pointer>> segments;
+  std::vector<size_t> bounds;
+
+  size_t size() const { return bounds.empty() ? 0 : bounds.size() - 1; }
+};
+
+template<typename Iterator>
+auto SplitOnBackets(Iterator first, Iterator last, size_t workers) {
+  using Pointer = typename Iterator::pointer;
+  Chunks<Pointer> result;
+  size_t total = 0;
+  ForEachSegment(first, last, [&](Pointer span_first, Pointer span_last) {
+    result.segments.push_back({span_first, span_last, total});
+    total += span_last - span_first;
+    return span_last;
+  });
+  if (result.segments.empty()) {
+    return result;
+  }
+  size_t chunks = std::min(result.segments.size(),
+                           workers * kParallelChunksPerWorker);
+  result.bounds.push_back(0);
+  for (size_t i = 1; i < result.segments.size(); ++i) {
+    // a chunk ends once its share of the elements is reached
+    size_t share = total * result.bounds.size() / chunks;
+    if (result.segments[i].offset >= share) {
+      result.bounds.push_back(i);
+    }
+  }
+  result.bounds.push_back(result.segments.size());
+  return result;
+}
+
+// Runs work(i) for i in [0, count), the first one on this thread.
+// Rethrows the first exception thrown after all of them finished. If
+// submit throws, the chunks not submitted are skipped and the submitted
+// ones are waited for, they refer to the locals here.
+template<typename Work>
+void RunChunks(ThreadPool& pool, size_t count, Work work) {
+  if (count == 0) {
+    return;
+  }
+  std::latch done(static_cast<std::ptrdiff_t>(count));
+  std::mutex mutex;
+  std::exception_ptr error;
+  auto run = [&](size_t i) {
+    try {
+      work(i);
+    } catch (...) {
+      std::lock_guard lock(mutex);
+      if (!error) {
+        error = std::current_exception();
+      }
+    }
+    done.count_down();
+  };
+  for (size_t i = 1; i < count; ++i) {
+    try {
+      pool.submit([&run, i] { run(i); });
+    } catch (...) {
+      // chunks i .. count - 1 and the first one never run
+      done.count_down(static_cast<std::ptrdiff_t>(count - i + 1));
+      done.wait();
+      throw;
+    }
+  }
+  run(0);
+  done.wait();
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+template<typename Iterator, typename Function>
+  requires DequeIterator<Iterator>
+void parallel_for_each(ThreadPool& pool, Iterator first, Iterator last,
+                       Function function) {
+  auto chunks = SplitOnBackets(first, last, pool.size());
+  RunChunks(pool, chunks.size(), [&](size_t chunk) {
+    for (size_t i = chunks.bounds[chunk]; i < chunks.bounds[chunk + 1]; ++i) {
+      for (auto* it = chunks.segments[i].first;
+           it != chunks.segments[i].last; ++it) {
+        function(*it);
+      }
+    }
+  });
+}
+
+// out has to be a random access iterator, it may be first itself
+template<typename Iterator, typename OutputIterator, typename Operation>
+  requires DequeIterator<Iterator>
+OutputIterator parallel_transform(ThreadPool& pool, Iterator first,
+                                  Iterator last, OutputIterator out,
+                                  Operation operation) {
+  static_assert(std::random_access_iterator<OutputIterator>,
+                "chunks are written in parallel");
+  auto chunks = SplitOnBackets(first, last, pool.size());
+  RunChunks(pool, chunks.size(), [&](size_t chunk) {
+    size_t from = chunks.bounds[chunk];
+    OutputIterator place = out + chunks.segments[from].offset;
+    for (size_t i = from; i < chunks.bounds[chunk + 1]; ++i) {
+      place = std::transform(chunks.segments[i].first,
+                             chunks.segments[i].last, place, operation);
+    }
+  });
+  return out + (last - first);
+}
+
+// operation has to be associative, chunks are folded into init in order
+template<typename Iterator, typename T,
+         typename BinaryOperation = std::plus<>>
+  requires DequeIterator<Iterator>
+T parallel_reduce(ThreadPool& pool, Iterator first, Iterator last, T init,
+                  BinaryOperation operation = BinaryOperation()) {
+  auto chunks = SplitOnBackets(first, last, pool.size());
+  std::vector<std::optional<T>> partial(chunks.size());
+  RunChunks(pool, chunks.size(), [&](size_t chunk) {
+    size_t from = chunks.bounds[chunk];
+    auto* it = chunks.segments[from].first;
+    T result = *it++;
+    for (size_t i = from; i < chunks.bounds[chunk + 1]; ++i) {
+      auto* span_last = chunks.segments[i].last;
+      for (; it != span_last; ++it) {
+        result = operation(std::move(result), *it);
+      }
+      if (i + 1 < chunks.bounds[chunk + 1]) {
+        it = chunks.segments[i + 1].first;
+      }
+    }
+    partial[chunk] = std::move(result);
+  });
+  for (auto& value : partial) {
+    init = operation(std::move(init), std::move(*value));
+  }
+  return init;
+}
+
+}  // namespace segmented
@@ -0,0 +1,104 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// What a Deque did with its memory, kept by a
+// Deque<T, Allocator, BacketSize, DequeStatistics>. The default
+// NoDequeStatistics is empty, such a deque has neither the counters nor
+// the code updating them. The counters belong to the deque object that
+// did the work, they are not carried over by copies, moves or swaps.
+struct NoDequeStatistics {};
+
+struct DequeStatistics {
+  uint64_t regrows = 0;             // maps reallocated larger
+  uint64_t recenters = 0;           // buckets rotated inside the map instead
+  uint64_t backets_allocated = 0;
+  uint64_t backets_freed = 0;
+  uint64_t peak_map_backets = 0;
+  uint64_t move_nanoseconds = 0;    // spent reallocating and recentering maps
+
+  // the state at the time Deque::statistics() was called
+  uint64_t map_backets = 0;
+  uint64_t idle_backets = 0;        // allocated but holding no element
+  uint64_t bytes_reserved = 0;      // by the buckets and the map
+  uint64_t bytes_used = 0;          // by the elements
+
+  // A single line JSON object with a member per counter.
+  std::string to_json() const;
+};
+
+namespace deque_statistics_detail {
+
+struct Field {
+  const char* name;
+  uint64_t DequeStatistics::* value;
+};
+
+inline constexpr Field kFields[] = {
+  {"regrows", &DequeStatistics::regrows},
+  {"recenters", &DequeStatistics::recenters},
+  {"backets_allocated", &DequeStatistics::backets_allocated},
+  {"backets_freed", &DequeStatistics::backets_freed},
+  {"peak_map_backets", &DequeStatistics::peak_map_backets},
+  {"move_nanoseconds", &DequeStatistics::move_nanoseconds},
+  {"map_backets", &DequeStatistics::map_backets},
+  {"idle_backets", &DequeStatistics::idle_backets},
+  {"bytes_reserved", &DequeStatistics::bytes_reserved},
+  {"bytes_used", &DequeStatistics::bytes_used},
+};
+
+}  // namespace deque_statistics_detail
+
+// One "name value" line per counter.
+inline std::ostream& operator<<(std::ostream& out,
+                                const DequeStatistics& statistics) {
+  for (const auto& field : deque_statistics_detail::kFields) {
+    out << field.name << ' ' << statistics.*field.value << '\n';
+  }
+  return out;
+}
+
+inline std::string DequeStatistics::to_json() const {
+  std::string result = "{";
+  for (const auto& field : deque_statistics_detail::kFields) {
+    if (result.size() > 1) {
+      result += ", ";
+    }
+    result += '"';
+    result += field.name;
+    result += "\": ";
+    result += std::to_string(this->*field.value);
+  }
+  result += '}';
+  return result;
+}
+
+// Adds the time between its construction and destruction to
+// move_nanoseconds, does nothing for NoDequeStatistics.
+template<typename Statistics>
+class DequeStatisticsTimer {
+ public:
+  explicit DequeStatisticsTimer(NoDequeStatistics&) {}
+};
+
+template<>
+class DequeStatisticsTimer<DequeStatistics> {
+ public:
+  explicit DequeStatisticsTimer(DequeStatistics& statistics)
+    : nanoseconds_(statistics.move_nanoseconds),
+      start_(std::chrono::steady_clock::now())
+  {}
+  DequeStatisticsTimer(const DequeStatisticsTimer&) = delete;
+  DequeStatisticsTimer& operator=(const DequeStatisticsTimer&) = delete;
+  ~DequeStatisticsTimer() {
+    nanoseconds_ += static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start_).count());
+  }
+
+ private:
+  uint64_t& nanoseconds_;
+  std::chrono::steady_clock::time_point start_;
+};
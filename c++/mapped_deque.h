@@ -0,0 +1,279 @@
+#pragma once
+#include "deque.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Bytes in one segment file of a MappedDeque by default, a multiple of
+// the page size.
+inline constexpr size_t kMappedBacketBytes = size_t(1) << 20;
+
+// Queue kept in a directory: every bucket is a segment file mapped with
+// MAP_SHARED and the positions are kept in a mapped header file. Pages of
+// the buckets in the middle can be written back and dropped by the kernel
+// like any file cache, so the queue may be larger than memory. Reopening
+// the directory maps the files again, nothing is read or parsed.
+// Segment files are numbered in queue order, a new one is created when
+// the back one is full and the front one is deleted once it is drained.
+// Elements are stored as their bytes, so T has to be trivially copyable
+// and the same type has to be used to reopen a queue. What was written is
+// in the page cache once a call returns, so it survives the process
+// dying. flush() writes it to the disk.
+// push_back and pop_front publish their change with one 8-byte store to
+// the header, a process dying at any point leaves the queue as it was
+// before or after the call. A segment file it had no time to delete is
+// deleted by the next open.
+template<typename T, size_t BacketSize = kMappedBacketBytes / sizeof(T)>
+class MappedDeque {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "elements are kept as bytes in files");
+
+ public:
+  // opens the queue kept in directory, or makes an empty one there
+  explicit MappedDeque(std::string directory);
+  MappedDeque(const MappedDeque&) = delete;
+  MappedDeque& operator=(const MappedDeque&) = delete;
+  ~MappedDeque();
+
+  void push_back(const T& value);
+  void pop_front();
+
+  T& operator[](size_t pos);
+  const T& operator[](size_t pos) const;
+  T& front() { return (*this)[0]; }
+  const T& front() const { return (*this)[0]; }
+  T& back() { return (*this)[size() - 1]; }
+  const T& back() const { return (*this)[size() - 1]; }
+
+  size_t size() const { return header_->tail - header_->head; }
+  bool empty() const { return size() == 0; }
+
+  // writes the buckets and the header to the disk and waits for it
+  void flush();
+
+ private:
+  static const size_t kBacketSize = BacketSize;
+  static_assert(kBacketSize > 0, "bucket can't be empty");
+  static constexpr size_t kBacketBytes = sizeof(T) * kBacketSize;
+  static constexpr uint64_t kMagic = 0x3275716544706d4d;   // "MmpDequ2"
+
+  // The whole persistent state besides the elements. Elements are
+  // numbered from the first one ever pushed, segment n holds elements
+  // [n * kBacketSize, (n + 1) * kBacketSize). head past tail is only
+  // left by a crash and means the queue is empty.
+  struct Header {
+    uint64_t magic;
+    uint64_t element_size;
+    uint64_t backet_size;
+    uint64_t head;                // number of the front element
+    uint64_t tail;                // number past the back element
+  };
+
+  // the element is written before the position that makes it visible
+  static void Publish(uint64_t& field, uint64_t value) {
+    std::atomic_ref<uint64_t>(field).store(value, std::memory_order_release);
+  }
+
+  static void* MapFile(const std::string& path, size_t bytes, bool create);
+  std::string SegmentPath(uint64_t segment) const;
+  T* MapSegment(uint64_t segment, bool create);
+  void RemoveStraySegments();
+  void DropFrontSegment();
+
+  std::string directory_;
+  Header* header_;
+  Deque<T*> map_;               // mapped segments from the front one
+};
+
+// Maps the whole file at path, which has to be bytes long. A new or empty
+// file is extended to bytes with zeros when create is set.
+template<typename T, size_t BacketSize>
+void* MappedDeque<T, BacketSize>::MapFile(const std::string& path,
+                                          size_t bytes, bool create) {
+  int fd = ::open(path.c_str(), O_RDWR | (create ? O_CREAT : 0), 0644);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), "open " + path);
+  }
+  struct stat status;
+  int error = 0;
+  if (::fstat(fd, &status) != 0) {
+    error = errno;
+  } else if (status.st_size == 0 && create) {
+    if (::ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+      error = errno;
+    }
+  } else if (static_cast<size_t>(status.st_size) != bytes) {
+    ::close(fd);
+    throw std::runtime_error(path + " has a wrong size");
+  }
+  void* mapped = MAP_FAILED;
+  if (error == 0) {
+    mapped = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED) {
+      error = errno;
+    }
+  }
+  // the mapping keeps the file open
+  ::close(fd);
+  if (error != 0) {
+    throw std::system_error(error, std::generic_category(), "map " + path);
+  }
+  return mapped;
+}
+
+template<typename T, size_t BacketSize>
+MappedDeque<T, BacketSize>::MappedDeque(std::string directory):
+  directory_(std::move(directory))
+{
+  if (::mkdir(directory_.c_str(), 0755) != 0 && errno != EEXIST) {
+    throw std::system_error(errno, std::generic_category(),
+                            "mkdir " + directory_);
+  }
+  header_ = static_cast<Header*>(
+      MapFile(directory_ + "/header", sizeof(Header), true));
+  try {
+    if (header_->magic == 0) {
+      header_->element_size = sizeof(T);
+      header_->backet_size = kBacketSize;
+      header_->head = 0;
+      header_->tail = 0;
+      header_->magic = kMagic;
+    } else if (header_->magic != kMagic) {
+      throw std::runtime_error(directory_ + " doesn't hold a queue");
+    } else if (header_->element_size != sizeof(T) ||
+               header_->backet_size != kBacketSize) {
+      throw std::runtime_error(directory_ + " holds another element type");
+    }
+    if (header_->head > header_->tail) {
+      Publish(header_->tail, header_->head);
+    }
+    RemoveStraySegments();
+    uint64_t first = header_->head / kBacketSize;
+    uint64_t last = (header_->tail + kBacketSize - 1) / kBacketSize;
+    for (uint64_t segment = first; segment < last; ++segment) {
+      T* values = MapSegment(segment, false);
+      map_.push_back(values);
+    }
+  } catch (...) {
+    for (T* values : map_) {
+      ::munmap(values, kBacketBytes);
+    }
+    ::munmap(header_, sizeof(Header));
+    throw;
+  }
+}
+
+template<typename T, size_t BacketSize>
+MappedDeque<T, BacketSize>::~MappedDeque() {
+  for (T* values : map_) {
+    ::munmap(values, kBacketBytes);
+  }
+  ::munmap(header_, sizeof(Header));
+}
+
+template<typename T, size_t BacketSize>
+std::string MappedDeque<T, BacketSize>::SegmentPath(uint64_t segment) const {
+  return directory_ + "/segment-" + std::to_string(segment);
+}
+
+template<typename T, size_t BacketSize>
+T* MappedDeque<T, BacketSize>::MapSegment(uint64_t segment, bool create) {
+  return static_cast<T*>(MapFile(SegmentPath(segment), kBacketBytes, create));
+}
+
+// Segments before the front one are left only by a crash between moving
+// the head and deleting the file. They are deleted in order, so they are
+// the ones right before it.
+template<typename T, size_t BacketSize>
+void MappedDeque<T, BacketSize>::RemoveStraySegments() {
+  for (uint64_t segment = header_->head / kBacketSize; segment > 0;) {
+    --segment;
+    if (::unlink(SegmentPath(segment).c_str()) != 0) {
+      break;
+    }
+  }
+}
+
+// The header moves on first, a crash in between leaves a stray file
+// behind but never a header pointing to a deleted one.
+template<typename T, size_t BacketSize>
+void MappedDeque<T, BacketSize>::DropFrontSegment() {
+  uint64_t segment = header_->head / kBacketSize - 1;
+  ::munmap(map_.front(), kBacketBytes);
+  map_.pop_front();
+  ::unlink(SegmentPath(segment).c_str());
+}
+
+template<typename T, size_t BacketSize>
+void MappedDeque<T, BacketSize>::push_back(const T& value) {
+  uint64_t tail = header_->tail;
+  if (tail % kBacketSize == 0) {
+    uint64_t segment = tail / kBacketSize;
+    T* values = MapSegment(segment, true);
+    try {
+      map_.push_back(values);
+    } catch (...) {
+      ::munmap(values, kBacketBytes);
+      ::unlink(SegmentPath(segment).c_str());
+      throw;
+    }
+  }
+  map_.back()[tail % kBacketSize] = value;
+  // counted only once it is written
+  Publish(header_->tail, tail + 1);
+}
+
+template<typename T, size_t BacketSize>
+void MappedDeque<T, BacketSize>::pop_front() {
+  if (empty()) {
+    return;
+  }
+  uint64_t head = header_->head + 1;
+  if (head == header_->tail && head % kBacketSize != 0) {
+    // an empty queue starts over at the next segment so that the front
+    // one can go, the head passing the tail already reads as empty
+    head += kBacketSize - head % kBacketSize;
+    Publish(header_->head, head);
+    Publish(header_->tail, head);
+  } else {
+    Publish(header_->head, head);
+  }
+  if (head % kBacketSize == 0) {
+    DropFrontSegment();
+  }
+}
+
+template<typename T, size_t BacketSize>
+T& MappedDeque<T, BacketSize>::operator[](size_t pos) {
+  size_t local = header_->head % kBacketSize + pos;
+  return map_[local / kBacketSize][local % kBacketSize];
+}
+
+template<typename T, size_t BacketSize>
+const T& MappedDeque<T, BacketSize>::operator[](size_t pos) const {
+  size_t local = header_->head % kBacketSize + pos;
+  return map_[local / kBacketSize][local % kBacketSize];
+}
+
+template<typename T, size_t BacketSize>
+void MappedDeque<T, BacketSize>::flush() {
+  for (T* values : map_) {
+    if (::msync(values, kBacketBytes, MS_SYNC) != 0) {
+      throw std::system_error(errno, std::generic_category(), "msync");
+    }
+  }
+  if (::msync(header_, sizeof(Header), MS_SYNC) != 0) {
+    throw std::system_error(errno, std::generic_category(), "msync");
+  }
+}
@@ -0,0 +1,382 @@
+#pragma once
+#include "deque.h"
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Deque that keeps up to InlineSize elements in the object itself, in a
+// ring over an inline bucket. The first push beyond that moves everything
+// into a Deque, and once that Deque is emptied again its memory is freed
+// and the inline bucket is used again. Deques that only ever hold a
+// handful of elements never allocate. Inline elements are constructed in
+// place and do not go through the allocator, only spilled ones do.
+template<typename T, size_t InlineSize,
+         typename Allocator = std::allocator<T>>
+class SmallDeque {
+  static constexpr bool kNothrowMoveAssign =
+      std::is_nothrow_move_constructible_v<T> &&
+      std::is_nothrow_move_assignable_v<Deque<T, Allocator>>;
+
+ public:
+  SmallDeque() = default;
+  explicit SmallDeque(const Allocator& alloc);
+  SmallDeque(const SmallDeque& other);
+  SmallDeque(SmallDeque&& other)
+      noexcept(std::is_nothrow_move_constructible_v<T>);
+  SmallDeque& operator=(const SmallDeque& other);
+  SmallDeque& operator=(SmallDeque&& other)
+      noexcept(kNothrowMoveAssign);
+  ~SmallDeque();
+
+  void push_back(const T& value);
+  void push_back(T&& value);
+  void push_front(const T& value);
+  void push_front(T&& value);
+  template<typename... Args>
+  T& emplace_back(Args&&... args);
+  template<typename... Args>
+  T& emplace_front(Args&&... args);
+  void pop_back();
+  void pop_front();
+
+  T& operator[](size_t pos);
+  const T& operator[](size_t pos) const;
+  T& front() { return (*this)[0]; }
+  const T& front() const { return (*this)[0]; }
+  T& back() { return (*this)[size() - 1]; }
+  const T& back() const { return (*this)[size() - 1]; }
+
+  size_t size() const;
+  bool empty() const { return size() == 0; }
+  // true while the elements are stored in the object itself
+  bool is_inline() const { return spilled_.size() == 0; }
+  Allocator get_allocator() const { return spilled_.get_allocator(); }
+
+  // positions in the deque, stay valid while elements are only added
+  // at the back
+  template<bool is_const>
+  class base_iterator {
+   public:
+    using Owner = std::conditional_t<is_const, const SmallDeque, SmallDeque>;
+    using reference = std::conditional_t<is_const, const T&, T&>;
+    using pointer = std::conditional_t<is_const, const T*, T*>;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using iterator_category = std::random_access_iterator_tag;
+
+    base_iterator() = default;
+    base_iterator(Owner* owner, difference_type position)
+      : owner_(owner), position_(position)
+    {}
+    base_iterator(const base_iterator<false>& other)
+      : owner_(other.owner_), position_(other.position_)
+    {}
+
+    reference operator*() const {
+      return (*owner_)[static_cast<size_t>(position_)];
+    }
+    pointer operator->() const { return &**this; }
+    reference operator[](difference_type value) const {
+      return (*owner_)[static_cast<size_t>(position_ + value)];
+    }
+
+    base_iterator& operator++() { ++position_; return *this; }
+    base_iterator& operator--() { --position_; return *this; }
+    base_iterator operator++(int) { return {owner_, position_++}; }
+    base_iterator operator--(int) { return {owner_, position_--}; }
+    base_iterator& operator+=(difference_type value) {
+      position_ += value;
+      return *this;
+    }
+    base_iterator& operator-=(difference_type value) {
+      position_ -= value;
+      return *this;
+    }
+    base_iterator operator+(difference_type value) const {
+      return {owner_, position_ + value};
+    }
+    base_iterator operator-(difference_type value) const {
+      return {owner_, position_ - value};
+    }
+    friend base_iterator operator+(difference_type value, base_iterator it) {
+      return it + value;
+    }
+    difference_type operator-(base_iterator other) const {
+      return position_ - other.position_;
+    }
+
+    bool operator==(const base_iterator& other) const {
+      return position_ == other.position_;
+    }
+    auto operator<=>(const base_iterator& other) const {
+      return position_ <=> other.position_;
+    }
+
+   private:
+    template<bool>
+    friend class base_iterator;
+
+    Owner* owner_ = nullptr;
+    difference_type position_ = 0;
+  };
+
+  using iterator = base_iterator<false>;
+  using const_iterator = base_iterator<true>;
+
+  iterator begin() { return {this, 0}; }
+  iterator end() { return {this, Signed(size())}; }
+  const_iterator begin() const { return {this, 0}; }
+  const_iterator end() const { return {this, Signed(size())}; }
+  const_iterator cbegin() const { return begin(); }
+  const_iterator cend() const { return end(); }
+
+ private:
+  static_assert(InlineSize > 0, "inline bucket can't be empty");
+
+  static std::ptrdiff_t Signed(size_t value) {
+    return static_cast<std::ptrdiff_t>(value);
+  }
+
+  T* Inline(size_t index);
+  const T* Inline(size_t index) const;
+  void Spill();
+  void DestroyInline();
+  void TakeInline(SmallDeque& other);
+  void Release();
+
+  alignas(T) unsigned char storage_[sizeof(T) * InlineSize];
+  size_t head_ = 0;                 // slot of the first inline element
+  size_t inline_size_ = 0;          // 0 while spilled_ holds the elements
+  Deque<T, Allocator> spilled_;
+};
+
+template<typename T, size_t InlineSize, typename Allocator>
+SmallDeque<T, InlineSize, Allocator>::SmallDeque(const Allocator& alloc):
+  spilled_(alloc)
+{}
+
+template<typename T, size_t InlineSize, typename Allocator>
+SmallDeque<T, InlineSize, Allocator>::SmallDeque(const SmallDeque& other):
+  spilled_(other.spilled_)
+{
+  try {
+    for (; inline_size_ < other.inline_size_; ++inline_size_) {
+      std::construct_at(Inline(inline_size_), *other.Inline(inline_size_));
+    }
+  } catch (...) {
+    DestroyInline();
+    throw;
+  }
+}
+
+template<typename T, size_t InlineSize, typename Allocator>
+SmallDeque<T, InlineSize, Allocator>::SmallDeque(SmallDeque&& other)
+    noexcept(std::is_nothrow_move_constructible_v<T>):
+  spilled_(std::move(other.spilled_))
+{
+  TakeInline(other);
+}
+
+template<typename T, size_t InlineSize, typename Allocator>
+SmallDeque<T, InlineSize, Allocator>&
+SmallDeque<T, InlineSize, Allocator>::operator=(const SmallDeque& other) {
+  if (this != &other) {
+    SmallDeque temp(other);
+    *this = std::move(temp);
+  }
+  return *this;
+}
+
+template<typename T, size_t InlineSize, typename Allocator>
+SmallDeque<T, InlineSize, Allocator>&
+SmallDeque<T, InlineSize, Allocator>::operator=(SmallDeque&& other)
+    noexcept(kNothrowMoveAssign) {
+  if (this != &other) {
+    DestroyInline();
+    spilled_ = std::move(other.spilled_);
+    TakeInline(other);
+  }
+  return *this;
+}
+
+template<typename T, size_t InlineSize, typename Allocator>
+SmallDeque<T, InlineSize, Allocator>::~SmallDeque() {
+  DestroyInline();
+}
+
+template<typename T, size_t InlineSize, typename Allocator>
+T* SmallDeque<T, InlineSize, Allocator>::Inline(size_t index) {
+  size_t slot = head_ + index;
+  if (slot >= InlineSize) {
+    slot -= InlineSize;
+  }
+  return std::launder(reinterpret_cast<T*>(storage_)) + slot;
+}
+
+template<typename T, size_t InlineSize, typename Allocator>
+const T* SmallDeque<T, InlineSize, Allocator>::Inline(size_t index) const {
+  return const_cast<SmallDeque*>(this)->Inline(index);
+}
+
+// Moves the inline elements to spilled_, the ring is appended as one or
+// two contiguous spans. A throwing move is not used when T can be copied,
+// so a failed spill leaves the inline elements as they were; for a T that
+// can only be moved with a throwing move the guarantee is the basic one.
+template<typename T, size_t InlineSize, typename Allocator>
+void SmallDeque<T, InlineSize, Allocator>::Spill() {
+  auto append = [this](T* from, T* to) {
+    if constexpr (std::is_nothrow_move_constructible_v<T> ||
+                  !std::is_copy_constructible_v<T>) {
+      spilled_.append(std::make_move_iterator(from),
+                      std::make_move_iterator(to));
+    } else {
+      spilled_.append(from, to);
+    }
+  };
+  T* first = Inline(0);
+  size_t head_part = std::min(inline_size_, InlineSize - head_);
+  try {
+    append(first, first + head_part);
+    T* wrapped = Inline(head_part);
+    append(wrapped, wrapped + inline_size_ - head_part);
+  } catch (...) {
+    Release();
+    throw;
+  }
+  DestroyInline();
+}
+
+template<typename T, size_t InlineSize, typename Allocator>
+void SmallDeque<T, InlineSize, Allocator>::DestroyInline() {
+  for (size_t i = 0; i < inline_size_; ++i) {
+    std::destroy_at(Inline(i));
+  }
+  head_ = 0;
+  inline_size_ = 0;
+}
+
+// Moves the inline elements of other here, nothing is stored inline yet.
+// A T whose move may throw is copied, so if it throws other keeps its
+// elements and the ones already built here are destroyed.
+template<typename T, size_t InlineSize, typename Allocator>
+void SmallDeque<T, InlineSize, Allocator>::TakeInline(SmallDeque& other) {
+  try {
+    for (; inline_size_ < other.inline_size_; ++inline_size_) {
+      std::construct_at(Inline(inline_size_),
+                        std::move_if_noexcept(*other.Inline(inline_size_)));
+    }
+  } catch (...) {
+    DestroyInline();
+    throw;
+  }
+  other.DestroyInline();
+}
+
+// Empties spilled_ and gives its memory back.
+template<typename T, size_t InlineSize, typename Allocator>
+void SmallDeque<T, InlineSize, Allocator>::Release() {
+  spilled_.clear();
+  spilled_.shrink_to_fit();
+}
+
+template<typename T, size_t InlineSize, typename Allocator>
+void SmallDeque<T, InlineSize, Allocator>::push_back(const T& value) {
+  emplace_back(value);
+}
+
+template<typename T, size_t InlineSize, typename Allocator>
+void SmallDeque<T, InlineSize, Allocator>::push_back(T&& value) {
+  emplace_back(std::move(value));
+}
+
+template<typename T, size_t InlineSize, typename Allocator>
+void SmallDeque<T, InlineSize, Allocator>::push_front(const T& value) {
+  emplace_front(value);
+}
+
+template<typename T, size_t InlineSize, typename Allocator>
+void SmallDeque<T, InlineSize, Allocator>::push_front(T&& value) {
+  emplace_front(std::move(value));
+}
+
+template<typename T, size_t InlineSize, typename Allocator>
+template<typename... Args>
+T& SmallDeque<T, InlineSize, Allocator>::emplace_back(Args&&... args) {
+  if (is_inline()) {
+    if (inline_size_ < InlineSize) {
+      T* place = Inline(inline_size_);
+      std::construct_at(place, std::forward<Args>(args)...);
+      ++inline_size_;
+      return *place;
+    }
+    // args may refer to an inline element, made before it moves
+    T value(std::forward<Args>(args)...);
+    Spill();
+    return spilled_.emplace_back(std::move(value));
+  }
+  return spilled_.emplace_back(std::forward<Args>(args)...);
+}
+
+template<typename T, size_t InlineSize, typename Allocator>
+template<typename... Args>
+T& SmallDeque<T, InlineSize, Allocator>::emplace_front(Args&&... args) {
+  if (is_inline()) {
+    if (inline_size_ < InlineSize) {
+      size_t new_head = head_ == 0 ? InlineSize - 1 : head_ - 1;
+      T* place = std::launder(reinterpret_cast<T*>(storage_)) + new_head;
+      std::construct_at(place, std::forward<Args>(args)...);
+      head_ = new_head;
+      ++inline_size_;
+      return *place;
+    }
+    T value(std::forward<Args>(args)...);
+    Spill();
+    return spilled_.emplace_front(std::move(value));
+  }
+  return spilled_.emplace_front(std::forward<Args>(args)...);
+}
+
+template<typename T, size_t InlineSize, typename Allocator>
+void SmallDeque<T, InlineSize, Allocator>::pop_back() {
+  if (!is_inline()) {
+    spilled_.pop_back();
+    if (spilled_.size() == 0) {
+      spilled_.shrink_to_fit();
+    }
+  } else if (inline_size_ != 0) {
+    std::destroy_at(Inline(--inline_size_));
+  }
+}
+
+template<typename T, size_t InlineSize, typename Allocator>
+void SmallDeque<T, InlineSize, Allocator>::pop_front() {
+  if (!is_inline()) {
+    spilled_.pop_front();
+    if (spilled_.size() == 0) {
+      spilled_.shrink_to_fit();
+    }
+  } else if (inline_size_ != 0) {
+    std::destroy_at(Inline(0));
+    head_ = head_ + 1 == InlineSize ? 0 : head_ + 1;
+    --inline_size_;
+  }
+}
+
+template<typename T, size_t InlineSize, typename Allocator>
+T& SmallDeque<T, InlineSize, Allocator>::operator[](size_t pos) {
+  return is_inline() ? *Inline(pos) : spilled_[pos];
+}
+
+template<typename T, size_t InlineSize, typename Allocator>
+const T& SmallDeque<T, InlineSize, Allocator>::operator[](size_t pos) const {
+  return is_inline() ? *Inline(pos) : spilled_[pos];
+}
+
+template<typename T, size_t InlineSize, typename Allocator>
+size_t SmallDeque<T, InlineSize, Allocator>::size() const {
+  return is_inline() ? inline_size_ : spilled_.size();
+}
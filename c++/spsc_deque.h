@@ -0,0 +1,164 @@
+#pragma once
+#include "deque.h"
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+
+// Unbounded queue for exactly one producer thread and one consumer thread.
+// Values are stored in a chain of buckets like in Deque. The producer
+// publishes every value with a release store of its counter, the consumer
+// hands finished buckets back by publishing the bucket it reads from, and
+// the producer reuses every bucket before it. Neither side ever waits for
+// the other, a new bucket is allocated only when none was handed back.
+template<typename T, size_t BacketSize = DefaultDequeBacketSize<T>()>
+class SpscDeque {
+ public:
+  SpscDeque();
+  SpscDeque(const SpscDeque&) = delete;
+  SpscDeque& operator=(const SpscDeque&) = delete;
+  ~SpscDeque();
+
+  // producer only
+  void push_back(const T& value);
+  void push_back(T&& value);
+  template<typename... Args>
+  void emplace_back(Args&&... args);
+
+  // consumer only, false if there is nothing to take
+  bool try_pop_front(T& value);
+  bool empty() const;
+
+  // from any thread, only a snapshot
+  size_t size() const;
+
+ private:
+  static const size_t kBacketSize = BacketSize;
+  static_assert(kBacketSize > 0, "bucket can't be empty");
+
+  struct Backet {
+    Backet* next = nullptr;
+    alignas(T) unsigned char storage[sizeof(T) * kBacketSize];
+
+    T* values() { return std::launder(reinterpret_cast<T*>(storage)); }
+  };
+
+  Backet* TakeFreeBacket();
+
+  // producer side
+  alignas(kCacheLineSize) Backet* tail_backet_;
+  size_t tail_index_;
+  Backet* oldest_backet_;       // buckets before the consumer's are free
+  std::atomic<size_t> pushed_;
+
+  // consumer side
+  alignas(kCacheLineSize) Backet* head_backet_;
+  size_t head_index_;
+  size_t known_pushed_;         // last value of pushed_ seen, saves loads
+  std::atomic<size_t> popped_;
+  std::atomic<Backet*> reading_backet_;
+};
+
+template<typename T, size_t BacketSize>
+SpscDeque<T, BacketSize>::SpscDeque():
+  tail_backet_(new Backet),
+  tail_index_(0),
+  oldest_backet_(tail_backet_),
+  pushed_(0),
+  head_backet_(tail_backet_),
+  head_index_(0),
+  known_pushed_(0),
+  popped_(0),
+  reading_backet_(tail_backet_)
+{}
+
+template<typename T, size_t BacketSize>
+SpscDeque<T, BacketSize>::~SpscDeque() {
+  size_t left = pushed_.load() - popped_.load();
+  for (; left > 0; --left) {
+    if (head_index_ == kBacketSize) {
+      head_backet_ = head_backet_->next;
+      head_index_ = 0;
+    }
+    std::destroy_at(head_backet_->values() + head_index_++);
+  }
+  while (oldest_backet_ != nullptr) {
+    delete std::exchange(oldest_backet_, oldest_backet_->next);
+  }
+}
+
+template<typename T, size_t BacketSize>
+void SpscDeque<T, BacketSize>::push_back(const T& value) {
+  emplace_back(value);
+}
+
+template<typename T, size_t BacketSize>
+void SpscDeque<T, BacketSize>::push_back(T&& value) {
+  emplace_back(std::move(value));
+}
+
+template<typename T, size_t BacketSize>
+template<typename... Args>
+void SpscDeque<T, BacketSize>::emplace_back(Args&&... args) {
+  if (tail_index_ == kBacketSize) {
+    // the link is published together with the first value put there
+    Backet* next = TakeFreeBacket();
+    tail_backet_->next = next;
+    tail_backet_ = next;
+    tail_index_ = 0;
+  }
+  std::construct_at(tail_backet_->values() + tail_index_,
+                    std::forward<Args>(args)...);
+  ++tail_index_;
+  pushed_.store(pushed_.load(std::memory_order_relaxed) + 1,
+                std::memory_order_release);
+}
+
+template<typename T, size_t BacketSize>
+typename SpscDeque<T, BacketSize>::Backet*
+SpscDeque<T, BacketSize>::TakeFreeBacket() {
+  if (oldest_backet_ != reading_backet_.load(std::memory_order_acquire)) {
+    Backet* result = oldest_backet_;
+    oldest_backet_ = oldest_backet_->next;
+    result->next = nullptr;
+    return result;
+  }
+  return new Backet;
+}
+
+template<typename T, size_t BacketSize>
+bool SpscDeque<T, BacketSize>::try_pop_front(T& value) {
+  size_t popped = popped_.load(std::memory_order_relaxed);
+  if (popped == known_pushed_) {
+    known_pushed_ = pushed_.load(std::memory_order_acquire);
+    if (popped == known_pushed_) {
+      return false;
+    }
+  }
+  if (head_index_ == kBacketSize) {
+    // every value of the old bucket is destroyed, the producer may reuse it
+    head_backet_ = head_backet_->next;
+    head_index_ = 0;
+    reading_backet_.store(head_backet_, std::memory_order_release);
+  }
+  T* place = head_backet_->values() + head_index_;
+  value = std::move(*place);
+  std::destroy_at(place);
+  ++head_index_;
+  popped_.store(popped + 1, std::memory_order_release);
+  return true;
+}
+
+template<typename T, size_t BacketSize>
+bool SpscDeque<T, BacketSize>::empty() const {
+  return popped_.load(std::memory_order_relaxed) ==
+         pushed_.load(std::memory_order_acquire);
+}
+
+template<typename T, size_t BacketSize>
+size_t SpscDeque<T, BacketSize>::size() const {
+  size_t popped = popped_.load(std::memory_order_acquire);
+  return pushed_.load(std::memory_order_acquire) - popped;
+}
@@ -13,6 +13,7 @@
 #include <sys/resource.h>
 
 #include "stackallocator.cpp"
+#include "deque.h"
 //#include "list.h"
 
 //template<typename T, typename Alloc = std::allocator<T>>
@@ -470,7 +471,7 @@ template <typename Alloc>
 void DequeTest() {
     Alloc alloc(STATIC_STORAGE);
 
-    std::deque<char, Alloc> d(alloc);
+    Deque<char, Alloc> d(alloc);
 
     d.push_back(1);
     assert(d.back() == 1);
@@ -0,0 +1,850 @@
+#include "blocking_deque.h"
+#include "byte_deque.h"
+#include "cow_deque.h"
+#include "deque.h"
+#include "deque_algorithm.h"
+#include "deque_allocators.h"
+#include "deque_io.h"
+#include "deque_parallel.h"
+#include "mapped_deque.h"
+#include "small_deque.h"
+#include "spsc_deque.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstddef>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    double NsPerOperation(Clock::time_point start, size_t operations) {
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start);
+        return static_cast<double>(elapsed.count()) / operations;
+    }
+
+    void Report(const std::string& name, double ns_per_operation) {
+        std::cout << "  " << name << ": " << ns_per_operation << " ns/op\n";
+    }
+
+    // keeps the compiler from throwing the loops away
+    volatile uint64_t sink = 0;
+
+    template<typename Container>
+    double RandomAccess(const Container& d, const std::vector<uint32_t>& positions) {
+        auto start = Clock::now();
+        uint64_t sum = 0;
+        for (int round = 0; round < 10; ++round) {
+            for (uint32_t pos : positions) {
+                sum += d[pos];
+            }
+        }
+        sink = sink + sum;
+        return NsPerOperation(start, positions.size() * 10);
+    }
+
+    template<typename Container>
+    double IteratorWalk(const Container& d) {
+        auto start = Clock::now();
+        uint64_t sum = 0;
+        for (int round = 0; round < 10; ++round) {
+            for (auto it = d.begin(); it != d.end(); ++it) {
+                sum += *it;
+            }
+        }
+        sink = sink + sum;
+        return NsPerOperation(start, d.size() * 10);
+    }
+
+    template<typename Container>
+    Container Filled(size_t size) {
+        Container d;
+        for (size_t i = 0; i < size; ++i) {
+            d.push_back(static_cast<uint32_t>(i));
+        }
+        return d;
+    }
+
+    // counts the bytes held through it, to see the footprint of a container
+    size_t live_bytes = 0;
+    size_t peak_bytes = 0;
+
+    template<typename T>
+    struct CountingAllocator {
+        using value_type = T;
+
+        CountingAllocator() = default;
+        template<typename U>
+        CountingAllocator(const CountingAllocator<U>&) {}
+
+        T* allocate(size_t count) {
+            live_bytes += count * sizeof(T);
+            peak_bytes = std::max(peak_bytes, live_bytes);
+            return std::allocator<T>().allocate(count);
+        }
+
+        void deallocate(T* pointer, size_t count) {
+            live_bytes -= count * sizeof(T);
+            std::allocator<T>().deallocate(pointer, count);
+        }
+
+        bool operator==(const CountingAllocator&) const { return true; }
+    };
+
+    void BenchmarkBacketSize() {
+        const size_t size = 10'000'000;
+        std::mt19937 g(31415);
+        std::vector<uint32_t> positions(size);
+        for (auto& pos : positions) {
+            pos = g() % size;
+        }
+
+        auto old_layout = Filled<Deque<uint32_t, std::allocator<uint32_t>, 100>>(size);
+        auto new_layout = Filled<Deque<uint32_t>>(size);
+
+        std::cout << "random operator[] over " << size << " elements\n";
+        Report("100 elements per bucket", RandomAccess(old_layout, positions));
+        Report(std::to_string(DefaultDequeBacketSize<uint32_t>()) + " elements per bucket",
+               RandomAccess(new_layout, positions));
+
+        std::cout << "iterator walk over " << size << " elements\n";
+        Report("100 elements per bucket", IteratorWalk(old_layout));
+        Report(std::to_string(DefaultDequeBacketSize<uint32_t>()) + " elements per bucket",
+               IteratorWalk(new_layout));
+    }
+
+    template<typename Run>
+    double Repeated(size_t size, Run run) {
+        auto start = Clock::now();
+        for (int round = 0; round < 10; ++round) {
+            run();
+        }
+        return NsPerOperation(start, size * 10);
+    }
+
+    void BenchmarkSegmentedAlgorithms() {
+        const size_t size = 10'000'000;
+        auto d = Filled<Deque<uint32_t>>(size);
+        std::vector<uint32_t> v(d.begin(), d.end());
+        std::vector<uint32_t> out(size);
+
+        std::cout << "accumulate over " << size << " elements\n";
+        Report("std, deque iterators", Repeated(size, [&] {
+            sink = sink + std::accumulate(d.begin(), d.end(), uint64_t(0));
+        }));
+        Report("segmented, deque iterators", Repeated(size, [&] {
+            sink = sink + segmented::accumulate(d.begin(), d.end(), uint64_t(0));
+        }));
+        Report("std, vector", Repeated(size, [&] {
+            sink = sink + std::accumulate(v.begin(), v.end(), uint64_t(0));
+        }));
+
+        std::cout << "find of a missing value over " << size << " elements\n";
+        Report("std, deque iterators", Repeated(size, [&] {
+            sink = sink + (std::find(d.begin(), d.end(), uint32_t(size)) == d.end());
+        }));
+        Report("segmented, deque iterators", Repeated(size, [&] {
+            sink = sink + (segmented::find(d.begin(), d.end(), uint32_t(size)) == d.end());
+        }));
+
+        std::cout << "copy to a vector of " << size << " elements\n";
+        Report("std, deque iterators", Repeated(size, [&] {
+            std::copy(d.begin(), d.end(), out.begin());
+            sink = sink + out.back();
+        }));
+        Report("segmented, deque iterators", Repeated(size, [&] {
+            segmented::copy(d.begin(), d.end(), out.begin());
+            sink = sink + out.back();
+        }));
+    }
+
+    void BenchmarkSteadyQueue() {
+        const size_t pairs = 100'000'000;
+        const size_t occupancy = 1000;
+        Deque<uint64_t, CountingAllocator<uint64_t>> queue;
+        for (size_t i = 0; i < occupancy; ++i) {
+            queue.push_back(i);
+        }
+
+        std::cout << pairs << " push_back/pop_front pairs, " << occupancy << " elements queued\n";
+        size_t checkpoint = pairs / 10;
+        auto start = Clock::now();
+        for (size_t i = 0; i < pairs; ++i) {
+            queue.push_back(i);
+            sink = sink + queue.front();
+            queue.pop_front();
+            if (i == checkpoint) {
+                std::cout << "  bytes held after " << checkpoint << " pairs: " << live_bytes << "\n";
+            }
+        }
+        Report("push_back + pop_front", NsPerOperation(start, pairs));
+        std::cout << "  bytes held at the end: " << live_bytes << ", peak: " << peak_bytes << "\n";
+    }
+
+    void BenchmarkSpsc() {
+        const size_t count = 20'000'000;
+        std::cout << count << " values from one thread to another\n";
+
+        {
+            std::mutex mutex;
+            Deque<uint64_t> queue;
+            auto start = Clock::now();
+            std::thread producer([&] {
+                for (size_t i = 0; i < count; ++i) {
+                    std::lock_guard lock(mutex);
+                    queue.push_back(i);
+                }
+            });
+            uint64_t sum = 0;
+            for (size_t taken = 0; taken < count; ) {
+                std::lock_guard lock(mutex);
+                if (queue.size() != 0) {
+                    sum += queue.front();
+                    queue.pop_front();
+                    ++taken;
+                }
+            }
+            producer.join();
+            sink = sink + sum;
+            Report("Deque with a mutex", NsPerOperation(start, count));
+        }
+
+        {
+            SpscDeque<uint64_t> queue;
+            auto start = Clock::now();
+            std::thread producer([&] {
+                for (size_t i = 0; i < count; ++i) {
+                    queue.push_back(i);
+                }
+            });
+            uint64_t sum = 0;
+            uint64_t value = 0;
+            for (size_t taken = 0; taken < count; ) {
+                if (queue.try_pop_front(value)) {
+                    sum += value;
+                    ++taken;
+                }
+            }
+            producer.join();
+            sink = sink + sum;
+            Report("SpscDeque", NsPerOperation(start, count));
+        }
+    }
+
+    void BenchmarkThreadPool() {
+        const size_t tasks = 100'000;
+        const size_t threads = std::max(2u, std::thread::hardware_concurrency());
+        std::cout << tasks << " small tasks on " << threads << " threads\n";
+        std::atomic<uint64_t> sum = 0;
+        auto work = [&sum](size_t task) {
+            uint64_t part = 0;
+            for (size_t i = 0; i < 1000; ++i) {
+                part += i ^ task;
+            }
+            sum += part;
+        };
+
+        {
+            auto start = Clock::now();
+            // a batch of fresh threads per round, as without a pool
+            for (size_t first = 0; first < tasks; first += threads * 100) {
+                std::vector<std::thread> batch;
+                for (size_t t = 0; t < threads; ++t) {
+                    batch.emplace_back([&work, first, t, tasks] {
+                        for (size_t i = first + t * 100; i < std::min(tasks, first + (t + 1) * 100); ++i) {
+                            work(i);
+                        }
+                    });
+                }
+                for (auto& thread : batch) {
+                    thread.join();
+                }
+            }
+            Report("threads per batch", NsPerOperation(start, tasks));
+        }
+
+        {
+            ThreadPool pool(threads);
+            auto start = Clock::now();
+            for (size_t i = 0; i < tasks; ++i) {
+                pool.submit([&work, i] { work(i); });
+            }
+            pool.wait();
+            Report("ThreadPool, submitted from outside", NsPerOperation(start, tasks));
+
+            start = Clock::now();
+            pool.submit([&pool, &work, tasks] {
+                for (size_t i = 0; i < tasks; ++i) {
+                    pool.submit([&work, i] { work(i); });
+                }
+            });
+            pool.wait();
+            Report("ThreadPool, fanned out by a worker", NsPerOperation(start, tasks));
+        }
+        sink = sink + sum.load();
+    }
+
+    void BenchmarkParallelAlgorithms() {
+        const size_t size = 50'000'000;
+        auto d = Filled<Deque<uint32_t>>(size);
+        std::cout << "per element update of " << size << " elements\n";
+
+        Report("segmented::for_each, this thread", Repeated(size, [&] {
+            segmented::for_each(d.begin(), d.end(), [](uint32_t& x) { x = x * 3 + 1; });
+        }));
+        for (size_t threads = 1; threads <= std::max(2u, std::thread::hardware_concurrency()); threads *= 2) {
+            ThreadPool pool(threads);
+            // the calling thread takes a chunk too
+            Report("parallel_for_each, pool of " + std::to_string(threads), Repeated(size, [&] {
+                segmented::parallel_for_each(pool, d.begin(), d.end(), [](uint32_t& x) { x = x * 3 + 1; });
+            }));
+            Report("parallel_reduce, pool of " + std::to_string(threads), Repeated(size, [&] {
+                sink = sink + segmented::parallel_reduce(pool, d.begin(), d.end(), uint64_t(0));
+            }));
+        }
+    }
+
+    // Baseline for the iterator benchmark: goes through operator[] on every
+    // dereference, so nothing about the current bucket is cached.
+    template<typename T, typename Container = Deque<T>>
+    class IndexIterator {
+     public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type*;
+        using reference = const value_type&;
+
+        IndexIterator(const Container* d, difference_type pos): d_(d), pos_(pos) {}
+
+        reference operator*() const { return (*d_)[pos_]; }
+        IndexIterator& operator++() { ++pos_; return *this; }
+        IndexIterator& operator--() { --pos_; return *this; }
+        IndexIterator& operator+=(difference_type n) { pos_ += n; return *this; }
+        IndexIterator operator-(difference_type n) const { return {d_, pos_ - n}; }
+        difference_type operator-(const IndexIterator& other) const { return pos_ - other.pos_; }
+        bool operator==(const IndexIterator& other) const { return pos_ == other.pos_; }
+        bool operator!=(const IndexIterator& other) const { return pos_ != other.pos_; }
+        bool operator<(const IndexIterator& other) const { return pos_ < other.pos_; }
+
+     private:
+        const Container* d_;
+        difference_type pos_;
+    };
+
+    template<typename Iterator>
+    void IterationRuns(const std::string& label, Iterator first, Iterator last, size_t size) {
+        Report("++ and *, " + label, Repeated(size, [&] {
+            uint64_t sum = 0;
+            for (auto it = first; it != last; ++it) {
+                sum += *it;
+            }
+            sink = sink + sum;
+        }));
+        Report("-- and *, " + label, Repeated(size, [&] {
+            uint64_t sum = 0;
+            for (auto it = last; it != first; ) {
+                sum += *--it;
+            }
+            sink = sink + sum;
+        }));
+        Report("reverse iterators, " + label, Repeated(size, [&] {
+            sink = sink + std::accumulate(std::reverse_iterator(last), std::reverse_iterator(first),
+                                          uint64_t(0));
+        }));
+        Report("+= 7 and *, " + label, Repeated(size / 7, [&] {
+            uint64_t sum = 0;
+            auto end = last - 7;
+            for (auto it = first; it < end; it += 7) {
+                sum += *it;
+            }
+            sink = sink + sum;
+        }));
+        Report("std::lower_bound, " + label, Repeated(size / 1000, [&] {
+            uint64_t found = 0;
+            for (uint32_t value = 0; value < size; value += 1000) {
+                found += std::lower_bound(first, last, value) - first;
+            }
+            sink = sink + found;
+        }));
+    }
+
+    void BenchmarkIteration() {
+        const size_t size = 10'000'000;
+        const auto d = Filled<Deque<uint32_t>>(size);
+        std::cout << "iteration over " << size << " elements\n";
+        using Baseline = IndexIterator<uint32_t>;
+        IterationRuns("operator[] baseline", Baseline(&d, 0), Baseline(&d, size), size);
+        IterationRuns("cached bounds", d.begin(), d.end(), size);
+    }
+
+    struct Order {
+        uint64_t id;
+        double price;
+        uint32_t quantity;
+        uint32_t flags;
+    };
+
+    void BenchmarkCopy() {
+        using Book = Deque<Order, CountingAllocator<Order>>;
+        const size_t size = 100'000;
+        Book book;
+        for (size_t i = 0; i < size; ++i) {
+            book.push_back({i, 100.0 + static_cast<double>(i % 50), 10, 0});
+        }
+        std::cout << "snapshots of " << size << " orders\n";
+        Report("copy construction", Repeated(size, [&] {
+            Book snapshot = book;
+            sink = sink + snapshot.back().id;
+        }));
+        Book snapshot;
+        snapshot = book;
+        size_t allocated = live_bytes;
+        peak_bytes = live_bytes;
+        Report("copy assignment", Repeated(size, [&] {
+            snapshot = book;
+            sink = sink + snapshot.back().id;
+        }));
+        std::cout << "  bytes allocated by copy assignment: "
+                  << peak_bytes - allocated << "\n";
+    }
+
+    void BenchmarkSnapshots() {
+        const size_t size = 1'000'000;
+        Deque<uint64_t> plain;
+        CowDeque<uint64_t> shared;
+        for (size_t i = 0; i < size; ++i) {
+            plain.push_back(i);
+            shared.push_back(i);
+        }
+        std::cout << "snapshot of " << size << " elements, then 1000 writes\n";
+        const size_t snapshots = 20;
+        auto start = Clock::now();
+        for (size_t round = 0; round < snapshots; ++round) {
+            Deque<uint64_t> snapshot = plain;
+            for (size_t i = 0; i < 1000; ++i) {
+                plain.pop_front();
+                plain.push_back(i);
+            }
+            sink = sink + snapshot.back();
+        }
+        Report("Deque copy", NsPerOperation(start, snapshots));
+        start = Clock::now();
+        for (size_t round = 0; round < snapshots; ++round) {
+            CowDeque<uint64_t> snapshot = shared;
+            for (size_t i = 0; i < 1000; ++i) {
+                shared.pop_front();
+                shared.push_back(i);
+            }
+            sink = sink + snapshot.back();
+        }
+        Report("CowDeque copy", NsPerOperation(start, snapshots));
+    }
+
+    template<typename Queue>
+    void QueueThroughput(const std::string& name, Queue& queue, size_t size) {
+        auto start = Clock::now();
+        for (size_t i = 0; i < size; ++i) {
+            queue.push_back(i);
+        }
+        Report(name + " push_back", NsPerOperation(start, size));
+        start = Clock::now();
+        uint64_t sum = 0;
+        for (size_t i = 0; i < size; ++i) {
+            sum += queue.front();
+            queue.pop_front();
+        }
+        sink = sink + sum;
+        Report(name + " front and pop_front", NsPerOperation(start, size));
+    }
+
+    void BenchmarkMapped() {
+        const size_t size = 20'000'000;
+        std::cout << "queue of " << size << " uint64\n";
+        Deque<uint64_t> in_memory;
+        QueueThroughput("Deque", in_memory, size);
+        char pattern[] = "/tmp/mapped_bench_XXXXXX";
+        std::string directory = mkdtemp(pattern);
+        {
+            MappedDeque<uint64_t> mapped(directory);
+            QueueThroughput("MappedDeque", mapped, size);
+        }
+        std::filesystem::remove_all(directory);
+    }
+
+    // Deque behind a mutex and a condition variable as worker pools wrap
+    // it by hand, unbounded and one notify per element
+    class LockedQueue {
+     public:
+        void push(uint64_t value) {
+            {
+                std::lock_guard lock(mutex_);
+                items_.push_back(value);
+            }
+            ready_.notify_one();
+        }
+
+        bool pop(uint64_t& value) {
+            std::unique_lock lock(mutex_);
+            ready_.wait(lock, [this] { return items_.size() != 0 || closed_; });
+            if (items_.size() == 0) {
+                return false;
+            }
+            value = items_.front();
+            items_.pop_front();
+            return true;
+        }
+
+        void close() {
+            {
+                std::lock_guard lock(mutex_);
+                closed_ = true;
+            }
+            ready_.notify_all();
+        }
+
+     private:
+        std::mutex mutex_;
+        std::condition_variable ready_;
+        Deque<uint64_t> items_;
+        bool closed_ = false;
+    };
+
+    // producers push count values in all, consumers take them until close
+    template<typename Queue, typename Produce, typename Consume>
+    double MpmcTime(Queue& queue, size_t count, size_t threads, Produce produce, Consume consume) {
+        std::atomic<uint64_t> sum = 0;
+        auto start = Clock::now();
+        std::vector<std::thread> producers;
+        std::vector<std::thread> consumers;
+        for (size_t t = 0; t < threads; ++t) {
+            producers.emplace_back([&queue, &produce, count, threads, t] {
+                produce(queue, t * count / threads, (t + 1) * count / threads);
+            });
+            consumers.emplace_back([&queue, &consume, &sum] { sum += consume(queue); });
+        }
+        for (auto& thread : producers) {
+            thread.join();
+        }
+        queue.close();
+        for (auto& thread : consumers) {
+            thread.join();
+        }
+        sink = sink + sum.load();
+        return NsPerOperation(start, count);
+    }
+
+    void BenchmarkBlocking() {
+        const size_t count = 4'000'000;
+        const size_t threads = 4;
+        const size_t batch = 256;
+        std::cout << count << " values through " << threads << " producers and " << threads << " consumers\n";
+        auto push_each = [](auto& queue, size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) {
+                queue.push(i);
+            }
+        };
+        auto pop_each = [](auto& queue) {
+            uint64_t sum = 0;
+            uint64_t value = 0;
+            while (queue.pop(value)) {
+                sum += value;
+            }
+            return sum;
+        };
+        {
+            LockedQueue queue;
+            Report("Deque, mutex and condition variable", MpmcTime(queue, count, threads, push_each, pop_each));
+        }
+        {
+            BlockingDeque<uint64_t> queue(4096);
+            Report("BlockingDeque, one at a time", MpmcTime(queue, count, threads, push_each, pop_each));
+        }
+        {
+            BlockingDeque<uint64_t> queue(4096);
+            auto push_batches = [batch](auto& queue, size_t first, size_t last) {
+                std::vector<uint64_t> values(batch);
+                for (size_t i = first; i < last; i += batch) {
+                    size_t size = std::min(batch, last - i);
+                    std::iota(values.begin(), values.begin() + size, uint64_t(i));
+                    queue.push_batch(values.begin(), values.begin() + size);
+                }
+            };
+            auto drain_batches = [batch](auto& queue) {
+                uint64_t sum = 0;
+                std::vector<uint64_t> values(batch);
+                while (size_t taken = queue.drain(values.begin(), batch)) {
+                    sum = std::accumulate(values.begin(), values.begin() + taken, sum);
+                }
+                return sum;
+            };
+            Report("BlockingDeque, batches of 256", MpmcTime(queue, count, threads, push_batches, drain_batches));
+        }
+    }
+
+    void BenchmarkAllocators() {
+        const size_t size = 64'000'000;
+        std::mt19937 g(27182);
+        std::vector<uint32_t> positions(10'000'000);
+        for (auto& pos : positions) {
+            pos = g() % size;
+        }
+        std::cout << "random operator[] over " << size << " uint32\n";
+        {
+            auto d = Filled<Deque<uint32_t>>(size);
+            Report("std::allocator", RandomAccess(d, positions));
+        }
+        {
+            auto d = Filled<Deque<uint32_t, HugePageAllocator<uint32_t>>>(size);
+            Report("HugePageAllocator", RandomAccess(d, positions));
+        }
+
+        const size_t walked = 10'000'000;
+        std::cout << "iterator walk over " << walked << " uint32 in 100 element buckets\n";
+        Report("std::allocator", IteratorWalk(Filled<Deque<uint32_t, std::allocator<uint32_t>, 100>>(walked)));
+        Report("AlignedAllocator", IteratorWalk(Filled<Deque<uint32_t, AlignedAllocator<uint32_t>, 100>>(walked)));
+    }
+
+    // 64 MB of lines of 20 to 99 bytes, written in 64 KB chunks and parsed
+    // back line by line
+    void BenchmarkByteStream() {
+        std::string stream;
+        std::mt19937 g(16180);
+        while (stream.size() < 64'000'000) {
+            stream.append(20 + g() % 80, 'x');
+            stream += '\n';
+        }
+        const size_t chunk = 65536;
+        std::cout << "parsing " << stream.size() << " bytes of lines\n";
+        {
+            auto start = Clock::now();
+            Deque<char> buffer;
+            size_t lines = 0;
+            std::string line;
+            for (size_t first = 0; first < stream.size(); first += chunk) {
+                for (size_t i = first; i < std::min(stream.size(), first + chunk); ++i) {
+                    buffer.push_back(stream[i]);
+                }
+                while (true) {
+                    auto end = std::find(buffer.begin(), buffer.end(), '\n');
+                    if (end == buffer.end()) {
+                        break;
+                    }
+                    line.assign(buffer.begin(), end);
+                    buffer.erase(buffer.begin(), end + 1);
+                    ++lines;
+                }
+            }
+            sink = sink + lines;
+            Report("Deque<char>, byte by byte", NsPerOperation(start, stream.size()));
+        }
+        {
+            auto start = Clock::now();
+            ByteDeque<> buffer;
+            size_t lines = 0;
+            std::string line;
+            for (size_t first = 0; first < stream.size(); first += chunk) {
+                buffer.write(stream.data() + first, std::min(chunk, stream.size() - first));
+                for (size_t end; (end = buffer.find('\n')) != ByteDeque<>::npos; ++lines) {
+                    line.resize(end);
+                    buffer.read(line.data(), end);
+                    buffer.consume(1);
+                }
+            }
+            sink = sink + lines;
+            Report("ByteDeque, write, find and read", NsPerOperation(start, stream.size()));
+        }
+    }
+
+    // merging two queues of size and splitting one in half, filling isn't
+    // timed
+    void BenchmarkSplice() {
+        const size_t size = 1'000'000;
+        std::cout << "two queues of " << size << " uint64\n";
+        double total = 0;
+        for (int round = 0; round < 10; ++round) {
+            auto first = Filled<Deque<uint64_t>>(size);
+            auto second = Filled<Deque<uint64_t>>(size);
+            auto start = Clock::now();
+            while (second.size() != 0) {
+                first.push_back(second.front());
+                second.pop_front();
+            }
+            total += NsPerOperation(start, size);
+            sink = sink + first.size();
+        }
+        Report("merged one by one", total / 10);
+
+        total = 0;
+        for (int round = 0; round < 10; ++round) {
+            auto first = Filled<Deque<uint64_t>>(size);
+            auto second = Filled<Deque<uint64_t>>(size - 7);
+            auto start = Clock::now();
+            first.splice_back(std::move(second));
+            total += NsPerOperation(start, size);
+            sink = sink + first.size();
+        }
+        Report("splice_back, offsets differ", total / 10);
+
+        // split_at allocates the buckets of the second half, splice_back
+        // of aligned halves only hands buckets over
+        double split_total = 0;
+        total = 0;
+        for (int round = 0; round < 10; ++round) {
+            auto first = Filled<Deque<uint64_t>>(2 * size);
+            auto start = Clock::now();
+            auto second = first.split_at(size + 3);
+            split_total += NsPerOperation(start, size);
+            start = Clock::now();
+            first.splice_back(std::move(second));
+            total += NsPerOperation(start, size);
+            sink = sink + first.size();
+        }
+        Report("split_at", split_total / 10);
+        Report("splice_back, offsets match", total / 10);
+    }
+
+    // average over 10 drains of size copies of value, filling isn't timed
+    template<typename T, typename Drain>
+    double DrainTime(size_t size, const T& value, Drain drain) {
+        double total = 0;
+        for (int round = 0; round < 10; ++round) {
+            Deque<T> d(size, value);
+            auto start = Clock::now();
+            drain(d);
+            total += NsPerOperation(start, size);
+            sink = sink + d.size();
+        }
+        return total / 10;
+    }
+
+    template<typename T>
+    void Drains(const std::string& name, const T& value) {
+        const size_t size = 1'000'000;
+        std::cout << "draining " << size << " " << name << "\n";
+        Report("pop_front one by one", DrainTime(size, value, [](Deque<T>& d) {
+            while (d.size() != 0) {
+                d.pop_front();
+            }
+        }));
+        Report("pop_front(1000)", DrainTime(size, value, [](Deque<T>& d) {
+            while (d.size() != 0) {
+                d.pop_front(1000);
+            }
+        }));
+        Report("clear", DrainTime(size, value, [](Deque<T>& d) { d.clear(); }));
+    }
+
+    void BenchmarkDrain() {
+        Drains("uint64", uint64_t(1));
+        Drains("strings of 32 chars", std::string(32, 'x'));
+    }
+
+    // a file in /tmp, so mostly the page cache is measured, not a disk
+    void BenchmarkSaveLoad() {
+        const size_t size = 32'000'000;
+        std::cout << "saving and loading " << size << " uint64\n";
+        Deque<uint64_t> d;
+        for (size_t i = 0; i < size; ++i) {
+            d.push_back(i);
+        }
+        FILE* file = std::tmpfile();
+        int fd = fileno(file);
+
+        auto start = Clock::now();
+        for (uint64_t value : d) {
+            std::fwrite(&value, sizeof(value), 1, file);
+        }
+        std::fflush(file);
+        Report("fwrite per element", NsPerOperation(start, size));
+        std::rewind(file);
+        start = Clock::now();
+        {
+            Deque<uint64_t> loaded;
+            uint64_t value;
+            while (std::fread(&value, sizeof(value), 1, file) == 1) {
+                loaded.push_back(value);
+            }
+            sink = sink + loaded.size();
+        }
+        Report("fread per element", NsPerOperation(start, size));
+
+        std::rewind(file);
+        start = Clock::now();
+        SaveDeque(fd, d);
+        Report("SaveDeque", NsPerOperation(start, size));
+        lseek(fd, 0, SEEK_SET);
+        start = Clock::now();
+        {
+            Deque<uint64_t> loaded;
+            LoadDeque(fd, loaded);
+            sink = sink + loaded.size();
+        }
+        Report("LoadDeque", NsPerOperation(start, size));
+        std::fclose(file);
+    }
+
+    // every session deque gets session % 4 elements, most stay tiny
+    template<typename Container>
+    void MostlyEmpty(const std::string& name, size_t sessions) {
+        live_bytes = peak_bytes = 0;
+        auto start = Clock::now();
+        {
+            std::vector<Container> deques(sessions);
+            for (size_t i = 0; i < sessions; ++i) {
+                for (size_t k = 0; k < i % 4; ++k) {
+                    deques[i].push_back(static_cast<uint32_t>(k));
+                }
+            }
+            sink = sink + deques.back().size();
+        }
+        double ns = NsPerOperation(start, sessions);
+        std::cout << "  " << name << ": " << ns << " ns and "
+                  << peak_bytes / sessions << " heap bytes per deque\n";
+    }
+
+    void BenchmarkMostlyEmpty() {
+        const size_t sessions = 1'000'000;
+        std::cout << sessions << " deques of 0 to 3 elements\n";
+        MostlyEmpty<Deque<uint32_t, CountingAllocator<uint32_t>>>("Deque", sessions);
+        MostlyEmpty<SmallDeque<uint32_t, 4, CountingAllocator<uint32_t>>>("SmallDeque<4>", sessions);
+    }
+}
+
+int main() {
+    BenchmarkBacketSize();
+    BenchmarkSegmentedAlgorithms();
+    BenchmarkSteadyQueue();
+    BenchmarkSpsc();
+    BenchmarkThreadPool();
+    BenchmarkParallelAlgorithms();
+    BenchmarkIteration();
+    BenchmarkMostlyEmpty();
+    BenchmarkCopy();
+    BenchmarkSnapshots();
+    BenchmarkMapped();
+    BenchmarkSaveLoad();
+    BenchmarkDrain();
+    BenchmarkBlocking();
+    BenchmarkAllocators();
+    BenchmarkByteStream();
+    BenchmarkSplice();
+    return 0;
+}
@@ -1,13 +1,41 @@
 #include "DequeTests.hpp"
 #include "TestLib.hpp"
+#include "blocking_deque.h"
+#include "byte_deque.h"
+#include "cow_deque.h"
 #include "deque.h"
+#include "deque_algorithm.h"
+#include "deque_allocators.h"
+#include "deque_io.h"
+#include "deque_parallel.h"
+#include "mapped_deque.h"
+#include "small_deque.h"
+#include "spsc_deque.h"
+#include "thread_pool.h"
+#include "work_stealing_deque.h"
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <filesystem>
+#include <numeric>
+#include <sstream>
 #include <tuple>
 #include <type_traits>
 #include <vector>
 #include <iterator>
+#include <list>
+#include <memory>
 #include <random>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
 
 
 namespace DequeTests {
@@ -24,6 +52,9 @@ namespace DequeTests {
         auto operator<=>(const NotDefaultConstructible&) const = default;
     };
 
+    template<typename D>
+    concept HasStatistics = requires(const D& d) { d.statistics(); };
+
     struct CountedException : public std::exception {
 
     };
@@ -47,6 +78,40 @@ namespace DequeTests {
         }
     };
 
+    inline int live_allocations = 0;
+
+    template<typename T, bool Propagate>
+    struct TrackingAllocator {
+        using value_type = T;
+        using propagate_on_container_copy_assignment = std::bool_constant<Propagate>;
+        using propagate_on_container_move_assignment = std::bool_constant<Propagate>;
+
+        template<typename U>
+        struct rebind {
+            using other = TrackingAllocator<U, Propagate>;
+        };
+
+        TrackingAllocator(int id): id(id) {}
+
+        template<typename U>
+        TrackingAllocator(const TrackingAllocator<U, Propagate>& other): id(other.id) {}
+
+        T* allocate(size_t count) {
+            ++live_allocations;
+            return std::allocator<T>().allocate(count);
+        }
+
+        void deallocate(T* pointer, size_t count) {
+            --live_allocations;
+            std::allocator<T>().deallocate(pointer, count);
+        }
+
+        bool operator==(const TrackingAllocator& other) const { return id == other.id; }
+        bool operator!=(const TrackingAllocator& other) const { return id != other.id; }
+
+        int id;
+    };
+
     template<typename iter, typename T>
     struct CheckIter{
         using traits = std::iterator_traits<iter>;
@@ -98,6 +163,217 @@ namespace DequeTests {
                 Deque<int> second(9, 9);
                 first = second;
                 test.check((first.size() == second.size()) && (first.size() == 9) && std::equal(first.begin(), first.end(), second.begin()));
+
+                // the front of a drained deque is past its last bucket
+                Deque<int> source(5, 1);
+                Deque<int> drained(2048);
+                drained.pop_front(2048);
+                drained = source;
+                test.check(drained.size() == 5 && std::count(drained.begin(), drained.end(), 1) == 5);
+                std::vector<int> values{1, 2, 3};
+                Deque<int> drained_again(2048);
+                drained_again.pop_front(2048);
+                drained_again.assign(values.begin(), values.end());
+                test.check(drained_again.size() == 3 && drained_again[2] == 3);
+                drained_again.push_back(4);
+                drained_again.push_front(0);
+                test.check(drained_again.size() == 5 && drained_again.front() == 0 && drained_again.back() == 4);
+            }),
+            make_pretty_test("bulk", [](auto& test){
+                std::vector<int> values(100'000);
+                std::iota(values.begin(), values.end(), 0);
+                Deque<int> from_range(values.begin(), values.end());
+                test.check(from_range.size() == values.size() && std::equal(values.begin(), values.end(), from_range.begin()));
+
+                std::list<std::string> words{"a", "bb", "ccc"};
+                Deque<std::string> from_list(words.begin(), words.end());
+                Deque<std::string> from_init{"a", "bb", "ccc"};
+                test.check(from_list.size() == 3 && std::equal(from_list.begin(), from_list.end(), from_init.begin()));
+
+                Deque<int> copy_of_deque(from_range.begin() + 10, from_range.end());
+                test.check(copy_of_deque.size() == values.size() - 10 && copy_of_deque[0] == 10);
+
+                Deque<char> bytes(5000, 'x');
+                test.check(std::count(bytes.begin(), bytes.end(), 'x') == 5000);
+                bytes.resize(10);
+                bytes.resize(20'000, 'y');
+                test.check(bytes.size() == 20'000 && bytes[9] == 'x' && bytes[10] == 'y' && bytes[19'999] == 'y');
+                bytes.resize(3);
+                test.check(bytes.size() == 3);
+
+                from_range.assign(5, 7);
+                test.check(from_range.size() == 5 && std::count(from_range.begin(), from_range.end(), 7) == 5);
+                from_range.assign(values.begin(), values.begin() + 50'000);
+                test.check(from_range.size() == 50'000 && from_range[49'999] == 49'999);
+                from_range.assign({1, 2, 3});
+                test.check(from_range.size() == 3 && from_range[2] == 3);
+                from_range.append(values.begin(), values.end());
+                test.check(from_range.size() == values.size() + 3 && from_range[3] == 0);
+
+                std::istringstream input("4 5 6");
+                from_range.append(std::istream_iterator<int>(input), std::istream_iterator<int>());
+                test.check(from_range[from_range.size() - 1] == 6);
+
+                Deque<int> zeros;
+                zeros.resize(3000);
+                test.check(std::count(zeros.begin(), zeros.end(), 0) == 3000);
+            }),
+            make_pretty_test("allocator", [](auto& test){
+                {
+                    using Propagating = TrackingAllocator<std::string, true>;
+                    Deque<std::string, Propagating> first(1000, "first", Propagating(1));
+                    Deque<std::string, Propagating> second(Propagating(2));
+                    second.push_back("second");
+                    second = first;
+                    test.check(second.get_allocator().id == 1 && second.size() == 1000);
+                    Deque<std::string, Propagating> third = std::move(first);
+                    test.check(third.get_allocator().id == 1 && third[999] == "first");
+                }
+                test.check(live_allocations == 0);
+                {
+                    using Sticky = TrackingAllocator<std::string, false>;
+                    Deque<std::string, Sticky> first(1000, "first", Sticky(1));
+                    Deque<std::string, Sticky> second(Sticky(2));
+                    second = first;
+                    test.check(second.get_allocator().id == 2 && second.size() == 1000);
+                    second = std::move(first);
+                    test.check(second.get_allocator().id == 2 && second[999] == "first");
+                    Deque<std::string, Sticky> same(Sticky(2));
+                    same = std::move(second);
+                    test.check(same.size() == 1000 && second.size() == 0);
+                    second.push_front("reused");
+                    test.check(second.front() == "reused" && same.back() == "first");
+                }
+                test.check(live_allocations == 0);
+            }),
+            make_pretty_test("aligned buckets", [](auto& test){
+                auto aligned = [](const auto& d) {
+                    bool result = true;
+                    bool first = true;
+                    for (auto segment : d.segments()) {
+                        // the front segment starts inside its bucket
+                        result &= first || reinterpret_cast<uintptr_t>(segment.data()) % 64 == 0;
+                        first = false;
+                    }
+                    return result;
+                };
+                Deque<uint64_t, AlignedAllocator<uint64_t>, 100> cache_lines;
+                for (uint64_t i = 0; i < 10'000; ++i) {
+                    cache_lines.push_back(i);
+                }
+                test.check(aligned(cache_lines) && cache_lines[5'000] == 5'000);
+
+                using Allocator = HugePageAllocator<uint64_t>;
+                // default constructed ones share one arena
+                test.check(Allocator() == HugePageAllocator<int>() && Allocator().arena() == DefaultHugePageArena());
+                Allocator allocator(std::make_shared<HugePageArena>());
+                test.check(allocator != Allocator());
+                {
+                    Deque<uint64_t, Allocator> huge(allocator);
+                    for (uint64_t i = 0; i < 1'000'000; ++i) {
+                        huge.push_back(i);
+                    }
+                    size_t mapped = allocator.arena()->mapped_bytes();
+                    test.check(mapped % kHugePageBytes == 0 && mapped >= 1'000'000 * sizeof(uint64_t));
+                    test.check(aligned(huge) && huge[123'456] == 123'456);
+
+                    // freed buckets are handed out again
+                    huge.pop_front(huge.size());
+                    huge.shrink_to_fit();
+                    for (uint64_t i = 0; i < 500'000; ++i) {
+                        huge.push_back(i);
+                    }
+                    test.check(allocator.arena()->mapped_bytes() <= mapped);
+
+                    Deque<uint64_t, Allocator> copy = huge;
+                    test.check(copy.get_allocator() == allocator && copy.back() == 499'999);
+                }
+                test.check(allocator.arena().use_count() == 1);
+            }),
+            make_pretty_test("lazy allocation", [](auto& test){
+                using Allocator = TrackingAllocator<int, true>;
+                int before = live_allocations;
+                {
+                    Deque<int, Allocator, 16> empty(Allocator(1));
+                    Deque<int, Allocator, 16> copy = empty;
+                    Deque<int, Allocator, 16> sized(0, Allocator(1));
+                    sized.resize(0);
+                    sized.assign({});
+                    copy = sized;
+                    test.check(live_allocations == before);
+                    test.check(empty.begin() == empty.end() && empty.segments().empty());
+
+                    // the map is sized for the elements right away, no regrowth
+                    Deque<int, Allocator, 16> filled(100, 7, Allocator(1));
+                    test.check(live_allocations - before == 100 / 16 + 1 + 1);
+                    Deque<int, Allocator, 16> copy_of_filled = filled;
+                    test.check(copy_of_filled.size() == 100 && copy_of_filled[99] == 7);
+
+                    empty.push_front(1);
+                    empty.push_back(2);
+                    test.check(empty.front() == 1 && empty.back() == 2);
+                }
+                test.check(live_allocations == before);
+            }),
+            make_pretty_test("copy in place", [](auto& test){
+                using Allocator = TrackingAllocator<int, false>;
+                int before = live_allocations;
+                {
+                    // starts mid bucket and ends on a bucket edge
+                    Deque<int, Allocator, 8> source(Allocator(1));
+                    for (int i = 0; i < 100; ++i) {
+                        source.push_back(i);
+                        source.push_front(-i);
+                    }
+                    source.pop_back();
+                    source.pop_back();
+                    source.pop_back();
+                    Deque<int, Allocator, 8> copy = source;
+                    test.check(std::equal(source.begin(), source.end(), copy.begin(), copy.end()));
+
+                    Deque<int, Allocator, 8> target(300, 5, Allocator(2));
+                    int allocated = live_allocations;
+                    target = source;
+                    test.check(live_allocations == allocated && target.get_allocator().id == 2);
+                    test.check(std::equal(source.begin(), source.end(), target.begin(), target.end()));
+                    target.push_front(1);
+                    target.push_back(2);
+                    test.check(target.size() == source.size() + 2 && target[1] == source[0]);
+                    allocated = live_allocations;
+                    Deque<int, Allocator, 8> empty(Allocator(3));
+                    target = empty;
+                    test.check(target.size() == 0 && live_allocations == allocated);
+                }
+                test.check(live_allocations == before);
+
+                Deque<std::string> words;
+                for (int i = 0; i < 1000; ++i) {
+                    words.push_back(std::to_string(i));
+                }
+                Deque<std::string> fewer(10, "x");
+                Deque<std::string> more(3000, "y");
+                fewer = words;
+                more = words;
+                test.check(fewer.size() == 1000 && more.size() == 1000 && fewer[999] == "999");
+                test.check(std::equal(words.begin(), words.end(), more.begin(), more.end()));
+            }),
+            make_pretty_test("move", [](auto& test){
+                Deque<std::string> source(1000, std::string(64, 'a'));
+                const std::string* first_element = &source[0];
+                Deque<std::string> moved = std::move(source);
+                test.check(moved.size() == 1000 && source.size() == 0);
+                // buckets are stolen, not copied
+                test.check(&moved[0] == first_element);
+
+                source.push_back("reused");
+                source.push_front("after move");
+                test.check(source.size() == 2 && source[0] == "after move" && source[1] == "reused");
+
+                source = std::move(moved);
+                test.check(source.size() == 1000 && moved.size() == 0 && &source[0] == first_element);
+
+                Deque<std::string> copy = moved;
+                test.check(copy.size() == 0);
             }),
             make_simple_test("static asserts", []{
                 using T1 = int;
@@ -115,6 +391,9 @@ namespace DequeTests {
                 static_assert(std::is_copy_assignable_v<Deque<T1>>, "should have assignment operator");
                 static_assert(std::is_copy_assignable_v<Deque<T2>>, "should have assignment operator");
 
+                static_assert(std::is_nothrow_move_constructible_v<Deque<T1>>, "should have noexcept move constructor");
+                static_assert(std::is_nothrow_move_assignable_v<Deque<T2>>, "should have noexcept move assignment");
+
                 return true;       
             })
         };
@@ -142,6 +421,152 @@ namespace DequeTests {
 
                 test.check(caught == 2);
             }),
+            make_pretty_test("segments", [](auto& test){
+                Deque<int, std::allocator<int>, 5> d;
+                test.check(d.segments().empty() && d.segments().begin() == d.segments().end());
+
+                for (int i = 0; i < 12; ++i) {
+                    d.push_back(i);
+                }
+                d.pop_front();
+                d.pop_front();
+                for (int i = 0; i < 4; ++i) {
+                    d.push_front(-1 - i);
+                }
+                // pop_back can leave the last bucket empty
+                while (d.back() != 10) {
+                    d.pop_back();
+                }
+
+                std::vector<int> joined;
+                size_t count = 0;
+                for (std::span<int> segment : d.segments()) {
+                    test.check(!segment.empty() && segment.size() <= 5);
+                    joined.insert(joined.end(), segment.begin(), segment.end());
+                    ++count;
+                }
+                test.check(count == d.segments().size());
+                test.check(std::equal(joined.begin(), joined.end(), d.begin(), d.end()));
+
+                for (std::span<int> segment : d.segments()) {
+                    segment[0] = 100;
+                }
+                const auto& constant = d;
+                static_assert(std::is_same_v<decltype(*constant.segments().begin()), std::span<const int>>);
+                static_assert(std::forward_iterator<Deque<int>::segments_type::iterator>);
+                test.check(constant.segments().size() == count);
+                test.check((*constant.segments().begin())[0] == 100 && d.front() == 100);
+
+                d.pop_front();
+                while (d.size() > 1) {
+                    d.pop_back();
+                }
+                test.check(d.segments().size() == 1 && (*d.segments().begin()).size() == 1);
+            }),
+            make_pretty_test("writev", [](auto& test){
+                Deque<char, std::allocator<char>, 7> d;
+                std::string expected;
+                for (int i = 0; i < 2000; ++i) {
+                    expected += char('a' + i % 26);
+                }
+                d.append(expected.begin(), expected.end());
+                d.pop_front();
+                expected.erase(0, 1);
+
+                auto iov = MakeIovec(d);
+                size_t total = 0;
+                for (const auto& piece : iov) {
+                    total += piece.iov_len;
+                }
+                test.check(iov.size() == d.segments().size() && total == d.size());
+
+                int fds[2];
+                test.check(pipe(fds) == 0);
+                while (d.size() != 0) {
+                    test.check(WriteDeque(fds[1], d) > 0);
+                }
+                close(fds[1]);
+                std::string received(expected.size(), 0);
+                size_t got = 0;
+                ssize_t part = 0;
+                while ((part = read(fds[0], received.data() + got, received.size() - got)) > 0) {
+                    got += part;
+                }
+                close(fds[0]);
+                test.check(got == expected.size() && received == expected);
+                test.check(WriteDeque(fds[1], d) == 0);
+            }),
+            make_pretty_test("save and load", [](auto& test){
+                Deque<long, std::allocator<long>, 7> d;
+                for (long i = 0; i < 3000; ++i) {
+                    d.push_back(i);
+                }
+                d.push_front(-1);
+                d.pop_front();
+                d.pop_front();
+                Deque<long, std::allocator<long>, 7> empty;
+
+                FILE* file = std::tmpfile();
+                int fd = fileno(file);
+                SaveDeque(fd, d);
+                SaveDeque(fd, empty);
+                test.check(lseek(fd, 0, SEEK_CUR) == off_t(2 * sizeof(DequeFileHeader) + 2999 * sizeof(long)));
+
+                lseek(fd, 0, SEEK_SET);
+                Deque<long, std::allocator<long>, 7> loaded(5, 7);
+                LoadDeque(fd, loaded);
+                test.check(loaded.size() == 2999 && std::equal(d.begin(), d.end(), loaded.begin()));
+                LoadDeque(fd, loaded);
+                test.check(loaded.size() == 0);
+
+                lseek(fd, 0, SEEK_SET);
+                Deque<int> other(3, 1);
+                int caught = 0;
+                try {
+                    LoadDeque(fd, other);
+                } catch (std::runtime_error&) {
+                    ++caught;
+                }
+                test.check(caught == 1 && other.size() == 3);
+
+                // cut in the middle of the elements
+                lseek(fd, 0, SEEK_SET);
+                test.check(ftruncate(fd, sizeof(DequeFileHeader) + 1000) == 0);
+                try {
+                    LoadDeque(fd, loaded);
+                } catch (std::runtime_error&) {
+                    ++caught;
+                }
+                test.check(caught == 2 && loaded.size() == 0);
+
+                // a size far beyond the file is refused before allocating
+                lseek(fd, 0, SEEK_SET);
+                DequeFileHeader huge{kDequeFileMagic, sizeof(long), uint64_t(1) << 60};
+                test.check(write(fd, &huge, sizeof(huge)) == ssize_t(sizeof(huge)));
+                lseek(fd, 0, SEEK_SET);
+                loaded.push_back(4);
+                try {
+                    LoadDeque(fd, loaded);
+                } catch (std::runtime_error&) {
+                    ++caught;
+                }
+                test.check(caught == 3 && loaded.size() == 1);
+
+                // through a pipe it is read a chunk at a time until it ends
+                int pipe_fds[2];
+                test.check(pipe(pipe_fds) == 0);
+                test.check(write(pipe_fds[1], &huge, sizeof(huge)) == ssize_t(sizeof(huge)));
+                test.check(write(pipe_fds[1], &huge, sizeof(huge)) == ssize_t(sizeof(huge)));
+                close(pipe_fds[1]);
+                try {
+                    LoadDeque(pipe_fds[0], loaded);
+                } catch (std::runtime_error&) {
+                    ++caught;
+                }
+                test.check(caught == 4 && loaded.size() == 1);
+                close(pipe_fds[0]);
+                std::fclose(file);
+            }),
             make_simple_test("static asserts", []{
                 Deque<size_t> defaulted;
                 const Deque<size_t> constant;
@@ -167,6 +592,9 @@ namespace DequeTests {
                 std::ignore = reverse_iter;
                 CheckIter<decltype(std::declval<Deque<int>>().cbegin()), const int> const_iter;
                 std::ignore = const_iter;
+                static_assert(std::random_access_iterator<Deque<int>::iterator>);
+                static_assert(std::random_access_iterator<Deque<int>::const_iterator>);
+                static_assert(std::is_signed_v<Deque<int>::iterator::difference_type>);
 
                 static_assert(std::is_convertible_v<
                         decltype(std::declval<Deque<int>>().begin()), 
@@ -202,6 +630,63 @@ namespace DequeTests {
                 Deque<int> d(1000, 3);
                 test.check(size_t((d.end() - d.begin())) == d.size());
                 test.check((d.begin() + d.size() == d.end()) && (d.end() - d.size() == d.begin()));
+
+                // distances and steps are signed
+                test.check(d.begin() - d.end() == -1000);
+                test.check(d.end() + (-1000) == d.begin() && d.begin() - (-1000) == d.end());
+                auto middle = d.begin() + 500;
+                middle += -300;
+                test.check(middle - d.begin() == 200 && (3 + middle) - middle == 3);
+                middle -= -100;
+                test.check(middle - d.begin() == 300 && d.begin() - middle == -300);
+                std::iota(d.begin(), d.end(), 0);
+                test.check(middle[-1] == 299 && middle[2] == 302);
+                test.check(std::distance(d.end(), d.begin()) == -1000);
+
+                // a full first bucket is the same position as the next bucket's start
+                Deque<int, std::allocator<int>, 4> small;
+                for (int i = 0; i < 9; ++i) {
+                    small.push_back(i);
+                }
+                for (int i = 0; i < 4; ++i) {
+                    small.pop_front();
+                }
+                test.check(small.end() - small.begin() == 5 && small.begin() < small.end());
+                test.check(small.begin() + 5 == small.end() && *small.begin() == 4);
+            }),
+            make_pretty_test("bucket edges", [](auto& test){
+                // shrink_to_fit leaves maps where begin() is the first slot and
+                // end() is one past the last one
+                bool consistent = true;
+                for (int count = 0; count < 24; ++count) {
+                    for (int popped = 0; popped <= count; ++popped) {
+                        Deque<int, std::allocator<int>, 4> d;
+                        for (int i = 0; i < count; ++i) {
+                            d.push_back(i);
+                        }
+                        for (int i = 0; i < popped; ++i) {
+                            d.pop_front();
+                        }
+                        d.shrink_to_fit();
+                        auto size = static_cast<std::ptrdiff_t>(d.size());
+                        consistent &= d.end() - d.begin() == size;
+                        consistent &= (d.begin() == d.end()) == (size == 0);
+                        consistent &= std::distance(d.rbegin(), d.rend()) == size;
+                        int expected = popped;
+                        for (auto it = d.begin(); it != d.end(); ++it) {
+                            consistent &= *it == expected++;
+                        }
+                        for (auto it = d.end(); it != d.begin(); ) {
+                            consistent &= *--it == --expected;
+                        }
+                        for (std::ptrdiff_t i = 0; i <= size; ++i) {
+                            consistent &= (d.begin() + i) - d.begin() == i;
+                            consistent &= (d.end() - i) + i == d.end();
+                            consistent &= d.begin() + i == d.end() - (size - i);
+                        }
+                    }
+                }
+                test.check(consistent);
             }),
             make_pretty_test("comparison", [](auto& test){
                 Deque<int> d(1000, 3);
@@ -229,6 +714,93 @@ namespace DequeTests {
                 //std::copy(d.begin(), d.end(), std::ostream_iterator<int>(std::cout, " "));
                 //std::cout << std::endl;
                 test.check(sorted_border - d.begin() == 500);
+            }),
+            make_pretty_test("segmented algos", [](auto& test){
+                // front part starts in the middle of a bucket
+                Deque<int, std::allocator<int>, 7> d;
+                for (int i = 0; i < 30; ++i) {
+                    d.push_front(-1 - i);
+                }
+                for (int i = 0; i < 70; ++i) {
+                    d.push_back(i);
+                }
+                std::vector<int> expected(d.begin(), d.end());
+
+                for (size_t from : {0, 3, 7, 50}) {
+                    for (size_t to : {size_t(50), size_t(51), d.size()}) {
+                        auto first = d.begin() + from;
+                        auto last = d.begin() + to;
+                        test.check(segmented::accumulate(first, last, 0L) ==
+                                   std::accumulate(expected.begin() + from, expected.begin() + to, 0L));
+                        test.check(segmented::find(first, last, 42) == std::find(first, last, 42));
+                        test.check(segmented::find(first, last, 1000) == last);
+                        test.check(segmented::count(first, last, 5) ==
+                                   size_t(std::count(first, last, 5)));
+                        long visited = 0;
+                        segmented::for_each(first, last, [&](int x) { visited += x; });
+                        test.check(visited == std::accumulate(first, last, 0L));
+                    }
+                }
+                test.check(segmented::find_if(d.cbegin(), d.cend(), [](int x) { return x > 68; }) ==
+                           d.cend() - 1);
+
+                std::vector<int> copied(d.size());
+                segmented::copy(d.cbegin(), d.cend(), copied.begin());
+                test.check(copied == expected);
+
+                Deque<int, std::allocator<int>, 7> other(d.size() + 5, 0);
+                segmented::copy(d.begin(), d.end(), other.begin() + 5);
+                test.check(std::equal(d.begin(), d.end(), other.begin() + 5));
+                segmented::copy(expected.begin(), expected.begin() + 10, other.begin() + 1);
+                test.check(std::equal(expected.begin(), expected.begin() + 10, other.begin() + 1));
+
+                segmented::fill(d.begin() + 13, d.end() - 13, 9);
+                test.check(segmented::count(d.begin(), d.end(), 9) == d.size() - 26);
+                test.check(d[12] == expected[12] && d[d.size() - 13] == expected[d.size() - 13]);
+
+                Deque<int> empty;
+                test.check(segmented::accumulate(empty.begin(), empty.end(), 0) == 0);
+                test.check(segmented::find(empty.begin(), empty.end(), 0) == empty.end());
+                std::list<int> list = {1, 2, 3};
+                test.check(segmented::accumulate(list.begin(), list.end(), 0) == 6);
+            }),
+            make_pretty_test("parallel algos", [](auto& test){
+                ThreadPool pool(3);
+                Deque<long, std::allocator<long>, 16> d;
+                for (long i = 0; i < 5'000; ++i) {
+                    d.push_back(i);
+                    d.push_front(-i - 1);
+                }
+                long expected = std::accumulate(d.begin(), d.end(), 0L);
+                test.check(segmented::parallel_reduce(pool, d.begin(), d.end(), 0L) == expected);
+                test.check(segmented::parallel_reduce(pool, d.begin() + 7, d.end() - 9, 5L) ==
+                           std::accumulate(d.begin() + 7, d.end() - 9, 5L));
+                test.check(segmented::parallel_reduce(pool, d.begin() + 3, d.begin() + 3, 5L) == 5);
+                // order of chunks is kept for non commutative operations
+                auto take_right = [](long, long right) { return right; };
+                test.check(segmented::parallel_reduce(pool, d.cbegin(), d.cend(), 0L, take_right) == d.back());
+
+                segmented::parallel_for_each(pool, d.begin() + 1, d.end(), [](long& x) { x *= 2; });
+                test.check(d.front() == -5'000 && d[1] == -9'998 && d.back() == 9'998);
+
+                std::vector<long> out(d.size());
+                auto out_end = segmented::parallel_transform(pool, d.begin(), d.end(), out.begin(),
+                                                             [](long x) { return x + 1; });
+                test.check(out_end == out.end() && out.front() == -4'999 && out.back() == 9'999);
+                segmented::parallel_transform(pool, d.begin(), d.end(), d.begin(), [](long x) { return -x; });
+                test.check(std::equal(d.begin(), d.end(), out.begin(), [](long x, long y) { return -x + 1 == y; }));
+
+                int caught = 0;
+                try {
+                    segmented::parallel_for_each(pool, d.begin(), d.end(), [](long x) {
+                        if (x == 42) {
+                            throw std::runtime_error("42");
+                        }
+                    });
+                } catch (std::runtime_error&) {
+                    ++caught;
+                }
+                test.check(caught == 1);
             })
         };
     }
@@ -295,6 +867,78 @@ namespace DequeTests {
                 test.check(d.size() == 5500 * 2 + 20);
                 test.check(std::count(d.begin(), d.end(), NotDefaultConstructible{1}) == 20);
                 test.check(std::count(d.begin(), d.end(), NotDefaultConstructible{2}) == 11000);
+
+                // two buckets with one used leave nothing to recenter into
+                Deque<int> small(1500);
+                small.pop_back(600);
+                small.push_front(1);
+                test.check(small.size() == 901);
+                test.check(small.front() == 1);
+                test.check(small.back() == 0);
+            }),
+            make_pretty_test("batch pops", [](auto& test){
+                Deque<int, std::allocator<int>, 16> d;
+                std::deque<int> expected;
+                std::mt19937 random(7);
+                int next = 0;
+                for (int round = 0; round < 2000; ++round) {
+                    size_t count = random() % 40;
+                    switch (random() % 4) {
+                    case 0:
+                        for (size_t i = 0; i < count; ++i) {
+                            d.push_back(next);
+                            expected.push_back(next++);
+                        }
+                        break;
+                    case 1:
+                        for (size_t i = 0; i < count; ++i) {
+                            d.push_front(next);
+                            expected.push_front(next++);
+                        }
+                        break;
+                    case 2:
+                        d.pop_front(count);
+                        expected.erase(expected.begin(), expected.begin() + std::min(count, expected.size()));
+                        break;
+                    default:
+                        d.pop_back(count);
+                        expected.erase(expected.end() - std::min(count, expected.size()), expected.end());
+                    }
+                    test.check(d.size() == expected.size() && std::equal(d.begin(), d.end(), expected.begin()));
+                }
+
+                using Element = Counted<-1>;
+                {
+                    Deque<Element, std::allocator<Element>, 8> counted(100);
+                    counted.pop_front(30);
+                    counted.pop_back(25);
+                    test.check(Element::counter == 45 && counted.size() == 45);
+                    counted.pop_front(1000);
+                    test.check(Element::counter == 0 && counted.size() == 0);
+                    counted.resize(50);
+                    counted.clear();
+                    test.check(Element::counter == 0 && counted.size() == 0);
+                    counted.emplace_back();
+                    counted.emplace_front();
+                    test.check(Element::counter == 2);
+                }
+                test.check(Element::counter == 0);
+
+                using Allocator = TrackingAllocator<int, true>;
+                int before = live_allocations;
+                Deque<int, Allocator, 16> queue(Allocator(1));
+                queue.clear();
+                for (int i = 0; i < 1000; ++i) {
+                    queue.push_back(i);
+                }
+                int held = live_allocations - before;
+                queue.clear();
+                for (int i = 0; i < 500; ++i) {
+                    queue.push_back(i);
+                    queue.push_front(i);
+                }
+                // both ends grew into the buckets clear kept
+                test.check(live_allocations - before == held && queue.size() == 1000);
             }),
             make_pretty_test("insert and erase", [](auto& test){
                 Deque<NotDefaultConstructible> d(10000, { 1 });
@@ -317,6 +961,375 @@ namespace DequeTests {
                 test.check(d.size() == copy.size());
                 test.check(std::equal(d.begin(), d.end(), copy.begin()));
             }),
+            make_pretty_test("growth", [](auto& test){
+                Deque<int> d;
+                int caught = 0;
+                try {
+                    d.set_growth_factor(1);
+                } catch (std::invalid_argument&) {
+                    ++caught;
+                }
+                test.check(caught == 1 && d.growth_factor() > 1);
+
+                d.set_growth_factor(1.5);
+                for (int i = 0; i < 100'000; ++i) {
+                    d.push_back(i);
+                    d.push_front(-i);
+                    if (i % 3 == 0) {
+                        d.pop_front();
+                    }
+                }
+                Deque<int> copy = d;
+                test.check(copy.growth_factor() == 1.5);
+                test.check(d.size() == 200'000 - 33'334);
+                test.check(d[d.size() - 1] == 99'999 && d[0] == -99'998);
+                test.check(std::is_sorted(d.begin(), d.end()));
+            }),
+            make_pretty_test("shrink and trim", [](auto& test){
+                using Allocator = TrackingAllocator<int, true>;
+                int before = live_allocations;
+                {
+                    Deque<int, Allocator, 16> d(Allocator(1));
+                    for (int i = 0; i < 10'000; ++i) {
+                        d.push_back(i);
+                    }
+                    int peak = live_allocations - before;
+                    for (int i = 0; i < 9'000; ++i) {
+                        d.pop_front();
+                    }
+                    test.check(live_allocations - before == peak);
+                    d.shrink_to_fit();
+                    // 1000 elements over 16 element buckets, and the map
+                    test.check(live_allocations - before <= 1000 / 16 + 2 + 1);
+                    test.check(d.front() == 9'000 && d.back() == 9'999);
+                    d.push_front(-1);
+                    d.push_back(10'000);
+                    test.check(d.size() == 1002 && d[1] == 9'000);
+
+                    while (d.size() != 0) {
+                        d.pop_back();
+                    }
+                    d.shrink_to_fit();
+                    test.check(live_allocations - before == 0);
+                    d.push_back(5);
+                    test.check(d.front() == 5 && d.size() == 1);
+                }
+                test.check(live_allocations == before);
+
+                Deque<int, Allocator, 16> queue(Allocator(1));
+                int caught = 0;
+                try {
+                    queue.set_trim_threshold(0.5);
+                } catch (std::invalid_argument&) {
+                    ++caught;
+                }
+                test.check(caught == 1 && queue.trim_threshold() == 0);
+                queue.set_trim_threshold(0.125);
+
+                int peak = 0;
+                for (int round = 0; round < 3; ++round) {
+                    for (int i = 0; i < 50'000; ++i) {
+                        queue.push_back(i);
+                    }
+                    peak = std::max(peak, live_allocations - before);
+                    for (int i = 0; i < 49'990; ++i) {
+                        queue.pop_front();
+                    }
+                    // peak footprint is given back once the queue drains
+                    test.check(live_allocations - before < peak / 8);
+                    test.check(queue.front() == 49'990 && queue.size() == 10);
+                    while (queue.size() != 0) {
+                        queue.pop_back();
+                    }
+                }
+                Deque<int, Allocator, 16> copy = queue;
+                test.check(copy.trim_threshold() == 0.125);
+            }),
+            make_pretty_test("splice and split", [](auto& test){
+                using Small = Deque<std::string, std::allocator<std::string>, 8>;
+                std::mt19937 random(11);
+                auto make = [&random](Small& d, std::deque<std::string>& expected, int count) {
+                    for (int i = 0; i < count; ++i) {
+                        std::string value = "v" + std::to_string(random() % 1000);
+                        if (random() % 3 == 0) {
+                            d.push_front(value);
+                            expected.push_front(value);
+                        } else {
+                            d.push_back(value);
+                            expected.push_back(value);
+                        }
+                    }
+                };
+                bool same = true;
+                for (int round = 0; round < 300; ++round) {
+                    Small first;
+                    Small second;
+                    std::deque<std::string> expected_first;
+                    std::deque<std::string> expected_second;
+                    make(first, expected_first, random() % 60);
+                    make(second, expected_second, random() % 60);
+
+                    size_t pos = random() % (first.size() + 1);
+                    Small tail = first.split_at(pos);
+                    same &= first.size() == pos && tail.size() == expected_first.size() - pos;
+                    same &= std::equal(first.begin(), first.end(), expected_first.begin());
+                    same &= std::equal(tail.begin(), tail.end(), expected_first.begin() + pos);
+                    // split parts share offsets and go back together bucket by bucket
+                    first.splice_back(std::move(tail));
+                    same &= tail.size() == 0 && std::equal(first.begin(), first.end(), expected_first.begin(), expected_first.end());
+
+                    if (round % 2 == 0) {
+                        first.splice_back(std::move(second));
+                        expected_first.insert(expected_first.end(), expected_second.begin(), expected_second.end());
+                    } else {
+                        first.splice_front(std::move(second));
+                        expected_first.insert(expected_first.begin(), expected_second.begin(), expected_second.end());
+                    }
+                    same &= second.size() == 0 && std::equal(first.begin(), first.end(), expected_first.begin(), expected_first.end());
+
+                    // both stay usable at both ends
+                    make(first, expected_first, 20);
+                    first.pop_front(3);
+                    expected_first.erase(expected_first.begin(), expected_first.begin() + std::min<size_t>(3, expected_first.size()));
+                    make(second, expected_second = {}, 20);
+                    same &= std::equal(first.begin(), first.end(), expected_first.begin(), expected_first.end());
+                    same &= std::equal(second.begin(), second.end(), expected_second.begin(), expected_second.end());
+                }
+                test.check(same);
+
+                using Allocator = TrackingAllocator<int, true>;
+                Deque<int, Allocator, 16> whole(Allocator(1));
+                for (int i = 0; i < 10'000; ++i) {
+                    whole.push_back(i);
+                }
+                Deque<int, Allocator, 16> half = whole.split_at(5'003);
+                int held = live_allocations;
+                whole.splice_back(std::move(half));
+                test.check(live_allocations == held && whole.size() == 10'000 && whole[5'003] == 5'003);
+
+                int caught = 0;
+                try {
+                    whole.split_at(10'001);
+                } catch (std::out_of_range&) {
+                    ++caught;
+                }
+                test.check(caught == 1);
+
+                // buckets of another allocator can't be taken over
+                Deque<int, Allocator, 16> other(Allocator(2));
+                other.push_back(-1);
+                whole.splice_front(std::move(other));
+                test.check(other.size() == 0 && whole.size() == 10'001 && whole[0] == -1 && whole[1] == 0);
+
+                // offsets that differ within a bucket, either side the smaller one
+                using Owned = Deque<std::unique_ptr<int>, std::allocator<std::unique_ptr<int>>, 8>;
+                bool in_order = true;
+                for (int extra : {2, 40}) {
+                    Owned left;
+                    Owned right;
+                    for (int i = 0; i < 5; ++i) {
+                        left.push_back(std::make_unique<int>(i));
+                    }
+                    // left ends at 5 past where right starts, right starts at 1
+                    right.push_back(nullptr);
+                    for (int i = 5; i < 5 + extra; ++i) {
+                        right.push_back(std::make_unique<int>(i));
+                    }
+                    right.pop_front();
+                    if (extra == 2) {
+                        left.splice_back(std::move(right));
+                    } else {
+                        right.splice_front(std::move(left));
+                        left = std::move(right);
+                    }
+                    in_order &= left.size() == size_t(5 + extra) && right.size() == 0;
+                    for (int i = 0; i < 5 + extra; ++i) {
+                        in_order &= *left[i] == i;
+                    }
+                }
+                test.check(in_order);
+            }),
+            make_pretty_test("statistics", [](auto& test){
+                // only asked for statistics cost anything
+                using Plain = Deque<int, std::allocator<int>, 16>;
+                static_assert(!HasStatistics<Plain>);
+                static_assert(sizeof(Plain) + sizeof(DequeStatistics) ==
+                              sizeof(Deque<int, std::allocator<int>, 16, DequeStatistics>));
+
+                Deque<int, std::allocator<int>, 16, DequeStatistics> d;
+                test.check(d.statistics().backets_allocated == 0 && d.statistics().bytes_reserved == 0);
+                for (int i = 0; i < 1000; ++i) {
+                    d.push_back(i);
+                }
+                DequeStatistics grown = d.statistics();
+                test.check(grown.regrows > 0 && grown.recenters == 0);
+                test.check(grown.backets_allocated == grown.map_backets && grown.backets_freed == 0);
+                test.check(grown.peak_map_backets == grown.map_backets && grown.map_backets >= 1000 / 16);
+                test.check(grown.idle_backets == grown.map_backets - (1000 + 8 + 15) / 16);
+                test.check(grown.bytes_used == 1000 * sizeof(int));
+                test.check(grown.bytes_reserved == grown.map_backets * 16 * sizeof(int) + (grown.map_backets + 1) * sizeof(int*));
+
+                // a queue of steady size moves its buckets around the map
+                for (int i = 0; i < 100'000; ++i) {
+                    d.push_back(i);
+                    d.pop_front();
+                }
+                DequeStatistics steady = d.statistics();
+                test.check(steady.recenters > 0 && steady.regrows == grown.regrows);
+                test.check(steady.backets_allocated == grown.backets_allocated);
+
+                // a smaller map is not a regrow
+                d.pop_back(d.size() - 10);
+                d.shrink_to_fit();
+                DequeStatistics trimmed = d.statistics();
+                test.check(trimmed.map_backets < steady.map_backets && trimmed.regrows == steady.regrows);
+
+                while (d.size() != 0) {
+                    d.pop_back();
+                }
+                d.shrink_to_fit();
+                DequeStatistics freed = d.statistics();
+                test.check(freed.backets_freed == freed.backets_allocated);
+                test.check(freed.map_backets == 0 && freed.bytes_reserved == 0 && freed.peak_map_backets == grown.peak_map_backets);
+
+                std::ostringstream text;
+                text << freed;
+                test.check(text.str().find("regrows " + std::to_string(freed.regrows) + "\n") == 0);
+                test.check(text.str().find("\nbytes_used 0\n") != std::string::npos);
+                std::string json = freed.to_json();
+                test.check(json.find("{\"regrows\": " + std::to_string(freed.regrows) + ", ") == 0);
+                test.check(json.find(", \"bytes_used\": 0}") == json.size() - 18);
+            }),
+            make_pretty_test("steady queue", [](auto& test){
+                using Allocator = TrackingAllocator<int, true>;
+                Deque<int, Allocator, 8> forward(Allocator(1));
+                Deque<int, Allocator, 8> backward(Allocator(1));
+                for (int i = 0; i < 100; ++i) {
+                    forward.push_back(i);
+                    backward.push_front(i);
+                }
+                int warmed_up = 0;
+                for (int i = 100; i < 200'000; ++i) {
+                    forward.push_back(i);
+                    forward.pop_front();
+                    backward.push_front(i);
+                    backward.pop_back();
+                    if (i == 10'000) {
+                        warmed_up = live_allocations;
+                    }
+                }
+                test.check(live_allocations == warmed_up);
+                test.check(forward.size() == 100 && forward.front() == 199'900 && forward.back() == 199'999);
+                test.check(backward.size() == 100 && backward.back() == 199'900 && backward.front() == 199'999);
+                test.check(std::is_sorted(forward.begin(), forward.end()));
+
+                // batches appended at the back reuse the buckets freed at the front
+                std::vector<int> batch(50);
+                for (int round = 0; round < 10'000; ++round) {
+                    std::iota(batch.begin(), batch.end(), round * 50);
+                    forward.append(batch.begin(), batch.end());
+                    for (int i = 0; i < 50; ++i) {
+                        forward.pop_front();
+                    }
+                    if (round == 100) {
+                        warmed_up = live_allocations;
+                    }
+                }
+                test.check(live_allocations == warmed_up);
+                test.check(forward.size() == 100 && forward.back() == 499'999);
+            }),
+            make_pretty_test("bucket sizes", [](auto& test){
+                static_assert(DefaultDequeBacketSize<char>() == 4096);
+                static_assert(DefaultDequeBacketSize<int32_t>() == 1024);
+                static_assert(DefaultDequeBacketSize<std::array<char, 10'000>>() == 16);
+
+                auto check = [&test](auto d) {
+                    std::vector<int> expected;
+                    for (int i = 0; i < 1000; ++i) {
+                        d.push_back(i);
+                        d.push_front(-i);
+                        expected.push_back(i);
+                        expected.insert(expected.begin(), -i);
+                    }
+                    std::vector<int> values(expected.begin(), expected.begin() + 300);
+                    d.insert(d.begin() + 700, values.begin(), values.end());
+                    expected.insert(expected.begin() + 700, values.begin(), values.end());
+                    d.erase(d.begin() + 1500, d.begin() + 1900);
+                    expected.erase(expected.begin() + 1500, expected.begin() + 1900);
+                    test.check(d.size() == expected.size() && std::equal(d.begin(), d.end(), expected.begin()));
+                    test.check(d[777] == expected[777] && *(d.end() - 3) == expected[expected.size() - 3]);
+                };
+                check(Deque<int, std::allocator<int>, 1>());
+                check(Deque<int, std::allocator<int>, 3>());
+                check(Deque<int, std::allocator<int>, 100>());
+                check(Deque<int>());
+            }),
+            make_pretty_test("range insert and erase", [](auto& test){
+                std::mt19937 g(27182);
+                Deque<int> d;
+                std::vector<int> expected;
+                Deque<std::string> strings;
+                std::vector<std::string> expected_strings;
+                for (int step = 0; step < 2000; ++step) {
+                    size_t pos = g() % (expected.size() + 1);
+                    size_t count = g() % 300;
+                    if (g() % 3 != 0) {
+                        std::vector<int> values(count);
+                        std::iota(values.begin(), values.end(), step * 1000);
+                        d.insert(d.begin() + pos, values.begin(), values.end());
+                        expected.insert(expected.begin() + pos, values.begin(), values.end());
+                        std::vector<std::string> string_values(count / 10, std::to_string(step));
+                        size_t string_pos = g() % (expected_strings.size() + 1);
+                        strings.insert(strings.begin() + string_pos, string_values.begin(), string_values.end());
+                        expected_strings.insert(expected_strings.begin() + string_pos, string_values.begin(), string_values.end());
+                    } else {
+                        count = std::min(count, expected.size() - pos);
+                        auto it = d.erase(d.begin() + pos, d.begin() + pos + count);
+                        expected.erase(expected.begin() + pos, expected.begin() + pos + count);
+                        test.check(size_t(it - d.begin()) == pos);
+                        if (!expected_strings.empty()) {
+                            size_t string_pos = g() % expected_strings.size();
+                            strings.erase(strings.begin() + string_pos);
+                            expected_strings.erase(expected_strings.begin() + string_pos);
+                        }
+                    }
+                }
+                test.check(d.size() == expected.size() && std::equal(d.begin(), d.end(), expected.begin()));
+                test.check(strings.size() == expected_strings.size() && std::equal(strings.begin(), strings.end(), expected_strings.begin()));
+
+                std::istringstream input("1 2 3 4 5");
+                d.insert(d.begin(), std::istream_iterator<int>(input), std::istream_iterator<int>());
+                test.check(d[0] == 1 && d[4] == 5);
+
+                using Allocator = TrackingAllocator<int, true>;
+                Deque<int, Allocator, 16> tracked(Allocator(1));
+                tracked.assign(40, 7);
+                std::istringstream tracked_input("10 20 30");
+                tracked.insert(tracked.begin() + 20, std::istream_iterator<int>(tracked_input),
+                               std::istream_iterator<int>());
+                test.check(tracked.size() == 43 && tracked[20] == 10 && tracked[22] == 30 && tracked[23] == 7);
+                test.check(tracked.get_allocator().id == 1);
+            }),
+            make_pretty_test("emplace and move only", [](auto& test){
+                Deque<std::unique_ptr<int>> d;
+                for (int i = 0; i < 1000; ++i) {
+                    d.emplace_back(std::make_unique<int>(i));
+                    d.push_front(std::make_unique<int>(-i));
+                }
+                test.check(d.size() == 2000);
+                test.check(*d[0] == -999 && *d[1999] == 999);
+
+                d.insert(d.begin() + 1000, std::make_unique<int>(12345));
+                test.check(d.size() == 2001 && *d[1000] == 12345 && *d[1001] == 0);
+                d.erase(d.begin() + 1000);
+                test.check(d.size() == 2000 && *d[1000] == 0);
+
+                Deque<std::pair<int, std::string>> pairs;
+                auto& back = pairs.emplace_back(1, "one");
+                auto& front = pairs.emplace_front(0, "zero");
+                test.check(back.second == "one" && front.first == 0);
+                test.check(&pairs[0] == &front && &pairs[1] == &back);
+            }),
             make_pretty_test("exceptions", [](auto& test) {
                 try {
                     Deque<Counted<17>> d(100);
@@ -330,12 +1343,643 @@ namespace DequeTests {
         };
     }
 
+    TestGroup create_small_deque_tests() {
+        return { "SmallDeque",
+            make_pretty_test("inline", [](auto& test){
+                using Allocator = TrackingAllocator<std::string, true>;
+                int before = live_allocations;
+                {
+                    SmallDeque<std::string, 4, Allocator> d(Allocator(1));
+                    // the ring wraps around in both directions
+                    for (int round = 0; round < 10; ++round) {
+                        d.push_back("b" + std::to_string(round));
+                        d.push_front("f" + std::to_string(round));
+                        d.push_back(d.front());
+                        d.pop_front();
+                        d.pop_back();
+                        d.pop_front();
+                    }
+                    d.push_back("x");
+                    d.push_front("w");
+                    d.emplace_back(3, 'y');
+                    d.emplace_front("v");
+                    test.check(d.is_inline() && live_allocations == before);
+                    test.check(d.size() == 4 && d[0] == "v" && d[1] == "w" && d.back() == "yyy");
+
+                    // the fifth element spills everything into the heap
+                    d.push_back(d.front());
+                    test.check(!d.is_inline() && live_allocations > before);
+                    test.check(d.size() == 5 && d[0] == "v" && d[2] == "x" && d[4] == "v");
+                    for (int i = 0; i < 100; ++i) {
+                        d.push_front(std::to_string(i));
+                    }
+                    test.check(d.size() == 105 && d.front() == "99" && d.back() == "v");
+
+                    while (!d.empty()) {
+                        d.pop_back();
+                    }
+                    test.check(d.is_inline() && live_allocations == before);
+                    d.push_back("again");
+                    test.check(d.size() == 1 && d.front() == "again" && live_allocations == before);
+                }
+                test.check(live_allocations == before);
+            }),
+            make_pretty_test("copy and move", [](auto& test){
+                SmallDeque<std::string, 3> small{};
+                small.push_back("a");
+                small.push_front("b");
+                SmallDeque<std::string, 3> large;
+                for (int i = 0; i < 50; ++i) {
+                    large.push_back(std::to_string(i));
+                }
+
+                SmallDeque<std::string, 3> copy = small;
+                test.check(copy.is_inline() && copy.size() == 2 && copy[0] == "b" && copy[1] == "a");
+                copy = large;
+                test.check(!copy.is_inline() && copy.size() == 50 && copy[49] == "49");
+                SmallDeque<std::string, 3> moved = std::move(copy);
+                test.check(moved.size() == 50 && copy.empty());
+                moved = small;
+                test.check(moved.is_inline() && moved.size() == 2 && moved.back() == "a");
+                moved = std::move(large);
+                test.check(moved.size() == 50 && large.empty() && moved.front() == "0");
+
+                std::vector<std::string> values(moved.begin(), moved.end());
+                test.check(values.size() == 50 && values[10] == "10");
+                const auto& constant = small;
+                test.check(std::count(constant.begin(), constant.end(), "a") == 1);
+                std::sort(small.begin(), small.end());
+                test.check(small[0] == "a" && small[1] == "b");
+                std::reverse(moved.begin(), moved.end());
+                test.check(moved.front() == "49" && moved.back() == "0");
+            }),
+            make_pretty_test("throwing spill", [](auto& test){
+                // copies fail once the budget runs out, the move may throw too
+                struct Fragile {
+                    int value;
+                    int* copies_left;
+
+                    Fragile(int value, int* copies_left): value(value), copies_left(copies_left) {}
+                    Fragile(const Fragile& other): value(other.value), copies_left(other.copies_left) {
+                        if ((*copies_left)-- == 0) {
+                            throw std::runtime_error("copy");
+                        }
+                    }
+                    Fragile(Fragile&& other): value(other.value), copies_left(other.copies_left) {
+                        other.value = -1;
+                    }
+                };
+                int copies_left = 1;
+                SmallDeque<Fragile, 2> d;
+                d.emplace_back(1, &copies_left);
+                d.emplace_front(0, &copies_left);
+                bool thrown = false;
+                try {
+                    d.emplace_back(2, &copies_left);
+                } catch (std::runtime_error&) {
+                    thrown = true;
+                }
+                // the spill copied, so the inline elements are untouched
+                test.check(thrown && d.is_inline() && d.size() == 2);
+                test.check(d[0].value == 0 && d[1].value == 1);
+                copies_left = 2;
+                d.emplace_back(2, &copies_left);
+                test.check(!d.is_inline() && d.size() == 3 && d[0].value == 0 && d[2].value == 2);
+            }),
+            make_pretty_test("throwing move", [](auto& test){
+                // the third element built by the move throws
+                using Element = Counted<7>;
+                {
+                    SmallDeque<Element, 4> d;
+                    for (int i = 0; i < 4; ++i) {
+                        d.emplace_back();
+                    }
+                    bool thrown = false;
+                    try {
+                        SmallDeque<Element, 4> moved(std::move(d));
+                    } catch (CountedException&) {
+                        thrown = true;
+                    }
+                    test.check(thrown && Element::counter == 4 && d.size() == 4);
+                    SmallDeque<Element, 4> target;
+                    try {
+                        target = std::move(d);
+                    } catch (CountedException&) {
+                        thrown = false;
+                    }
+                    test.check(!thrown && Element::counter == 4 && target.empty() && d.size() == 4);
+                }
+                test.check(Element::counter == 0);
+            }),
+            make_simple_test("static asserts", []{
+                using Small = SmallDeque<int, 8>;
+                static_assert(std::random_access_iterator<Small::iterator>);
+                static_assert(std::random_access_iterator<Small::const_iterator>);
+                static_assert(std::is_convertible_v<Small::iterator, Small::const_iterator>);
+                static_assert(std::is_nothrow_move_constructible_v<Small>);
+                static_assert(std::is_nothrow_move_assignable_v<Small>);
+                return true;
+            })
+        };
+    }
+
+    TestGroup create_cow_tests() {
+        return { "CowDeque",
+            make_pretty_test("snapshots", [](auto& test){
+                auto shared = std::make_shared<int>(0);
+                {
+                    CowDeque<std::shared_ptr<int>, 4> d;
+                    for (int i = 0; i < 10; ++i) {
+                        d.push_back(shared);
+                        d.push_front(shared);
+                    }
+                    // buckets are shared, not the elements
+                    CowDeque<std::shared_ptr<int>, 4> snapshot = d;
+                    test.check(shared.use_count() == 21 && snapshot.size() == 20);
+
+                    d.push_back(std::make_shared<int>(1));
+                    d.pop_front();
+                    test.check(snapshot.size() == 20 && snapshot.back() == shared && snapshot.front() == shared);
+                    test.check(d.size() == 20 && *d.back() == 1);
+                    // only the two end buckets were cloned
+                    test.check(shared.use_count() <= 21 + 4 + 4);
+                }
+                test.check(shared.use_count() == 1);
+
+                CowDeque<int, 4> d;
+                for (int i = 0; i < 100; ++i) {
+                    d.push_back(i);
+                }
+                std::vector<CowDeque<int, 4>> snapshots;
+                for (int round = 0; round < 10; ++round) {
+                    snapshots.push_back(d);
+                    for (int i = 0; i < 7; ++i) {
+                        d.pop_front();
+                        d.push_back(100 + round * 7 + i);
+                    }
+                    d.pop_back();
+                    d.push_front(-1);
+                }
+                bool consistent = true;
+                for (int round = 0; round < 10; ++round) {
+                    const auto& snapshot = snapshots[round];
+                    consistent &= snapshot.size() == 100;
+                    std::vector<int> values(snapshot.begin(), snapshot.end());
+                    consistent &= std::equal(values.begin(), values.end(), snapshot.begin(), snapshot.end());
+                    if (round == 0) {
+                        consistent &= snapshot.front() == 0 && snapshot.back() == 99;
+                    } else {
+                        // written by the previous round
+                        consistent &= snapshot.front() == -1 && snapshot.at(99) == 100 + round * 7 - 2;
+                    }
+                }
+                test.check(consistent);
+                test.check(d.size() == 100 && d.front() == -1 && d.back() == 100 + 10 * 7 - 2);
+
+                while (!d.empty()) {
+                    d.pop_back();
+                }
+                test.check(snapshots.back().size() == 100 && snapshots.back()[1] == snapshots[9][1]);
+                snapshots[3] = snapshots[9];
+                snapshots[9] = std::move(snapshots[0]);
+                test.check(snapshots[9].front() == 0 && snapshots[0].empty() && snapshots[3].front() == -1);
+            }),
+            make_pretty_test("reader threads", [](auto& test){
+                CowDeque<std::string, 8> d;
+                std::atomic<bool> consistent = true;
+                std::vector<std::thread> readers;
+                for (int round = 0; round < 50; ++round) {
+                    // after the first round every snapshot holds round .. round + 99
+                    readers.emplace_back([snapshot = d, &consistent] {
+                        for (size_t i = 1; i < snapshot.size(); ++i) {
+                            if (std::stoi(snapshot[i]) != std::stoi(snapshot[i - 1]) + 1) {
+                                consistent = false;
+                            }
+                        }
+                    });
+                    if (d.empty()) {
+                        for (int i = 0; i < 100; ++i) {
+                            d.push_back(std::to_string(i));
+                        }
+                    }
+                    d.pop_front();
+                    d.push_back(std::to_string(std::stoi(d.back()) + 1));
+                }
+                for (auto& reader : readers) {
+                    reader.join();
+                }
+                test.check(consistent.load() && d.size() == 100 && d.front() == "50");
+            })
+        };
+    }
+
+    TestGroup create_mapped_tests() {
+        return { "MappedDeque",
+            make_pretty_test("reopen", [](auto& test){
+                char pattern[] = "/tmp/mapped_deque_XXXXXX";
+                std::string directory = mkdtemp(pattern);
+                auto segment_files = [&directory] {
+                    return std::count_if(std::filesystem::directory_iterator(directory),
+                                         std::filesystem::directory_iterator(),
+                                         [](const auto& entry) {
+                                             return entry.path().filename().string().starts_with("segment-");
+                                         });
+                };
+                {
+                    MappedDeque<uint64_t, 512> queue(directory);
+                    test.check(queue.empty());
+                    for (uint64_t i = 0; i < 10'000; ++i) {
+                        queue.push_back(i * 3);
+                    }
+                    for (int i = 0; i < 1000; ++i) {
+                        queue.pop_front();
+                    }
+                    queue.back() = 7;
+                    test.check(queue.size() == 9000 && queue.front() == 3000 && queue[8998] == 29'994);
+                    // drained segments are deleted
+                    test.check(segment_files() == (9000 + 1000 % 512 + 511) / 512);
+                    queue.flush();
+                }
+                {
+                    MappedDeque<uint64_t, 512> queue(directory);
+                    bool same = queue.size() == 9000 && queue.back() == 7;
+                    for (uint64_t i = 0; i + 1 < queue.size(); ++i) {
+                        same &= queue[i] == (1000 + i) * 3;
+                    }
+                    test.check(same);
+                    while (queue.size() > 1) {
+                        queue.pop_front();
+                    }
+                    queue.push_back(8);
+                    test.check(queue.front() == 7 && queue.back() == 8);
+                    queue.pop_front();
+                    queue.pop_front();
+                    test.check(queue.empty() && segment_files() == 0);
+                    queue.push_back(9);
+                }
+                // a segment left by dying before its file was deleted
+                std::FILE* stray = std::fopen((directory + "/segment-19").c_str(), "w");
+                std::fclose(stray);
+                {
+                    MappedDeque<uint64_t, 512> queue(directory);
+                    test.check(queue.size() == 1 && queue.front() == 9);
+                    test.check(segment_files() == 1);
+                }
+                int caught = 0;
+                try {
+                    MappedDeque<uint32_t, 512> other_type(directory);
+                } catch (std::runtime_error&) {
+                    ++caught;
+                }
+                test.check(caught == 1);
+                std::filesystem::remove_all(directory);
+            })
+        };
+    }
+
+    TestGroup create_spsc_tests() {
+        return { "SpscDeque",
+            make_pretty_test("one thread", [](auto& test){
+                SpscDeque<std::unique_ptr<int>, 4> queue;
+                std::unique_ptr<int> value;
+                test.check(queue.empty() && !queue.try_pop_front(value));
+
+                int next_pushed = 0;
+                int next_popped = 0;
+                bool in_order = true;
+                for (int round = 0; round < 50; ++round) {
+                    for (int i = 0; i < round % 7 + 1; ++i) {
+                        queue.push_back(std::make_unique<int>(next_pushed++));
+                    }
+                    for (int i = 0; i < round % 5 + 1 && queue.try_pop_front(value); ++i) {
+                        in_order &= *value == next_popped++;
+                    }
+                }
+                test.check(in_order);
+                test.check(queue.size() == size_t(next_pushed - next_popped));
+
+                // values still queued are destroyed with the queue
+                auto shared = std::make_shared<int>(0);
+                {
+                    SpscDeque<std::shared_ptr<int>, 3> holder;
+                    for (int i = 0; i < 10; ++i) {
+                        holder.push_back(shared);
+                    }
+                    std::shared_ptr<int> taken;
+                    holder.try_pop_front(taken);
+                    test.check(shared.use_count() == 11);
+                }
+                test.check(shared.use_count() == 1);
+            }),
+            make_pretty_test("two threads", [](auto& test){
+                const int count = 1'000'000;
+                SpscDeque<int, 16> queue;
+                std::thread producer([&queue] {
+                    for (int i = 0; i < count; ++i) {
+                        queue.push_back(i);
+                    }
+                });
+                bool in_order = true;
+                int value = 0;
+                for (int expected = 0; expected < count; ) {
+                    if (queue.try_pop_front(value)) {
+                        in_order &= value == expected++;
+                    }
+                }
+                producer.join();
+                test.check(in_order && queue.empty());
+            })
+        };
+    }
+
+    TestGroup create_blocking_tests() {
+        return { "BlockingDeque",
+            make_pretty_test("one thread", [](auto& test){
+                using namespace std::chrono_literals;
+                BlockingDeque<std::unique_ptr<int>, 4> queue(10);
+                test.check(queue.capacity() == 10 && queue.size() == 0);
+                std::unique_ptr<int> value;
+                test.check(!queue.pop_for(value, 1ms));
+
+                std::vector<std::unique_ptr<int>> batch;
+                for (int i = 0; i < 9; ++i) {
+                    batch.push_back(std::make_unique<int>(i));
+                }
+                test.check(queue.push_batch(std::make_move_iterator(batch.begin()),
+                                            std::make_move_iterator(batch.end())) == 9);
+                test.check(queue.push(std::make_unique<int>(9)));
+                // full, the value stays with the caller
+                value = std::make_unique<int>(10);
+                test.check(!queue.push_for(std::move(value), 1ms) && value && queue.size() == 10);
+
+                std::vector<std::unique_ptr<int>> out;
+                test.check(queue.drain(std::back_inserter(out), 7) == 7);
+                test.check(queue.pop(value) && *value == 7);
+                test.check(queue.push_for(std::make_unique<int>(10), 1ms));
+                test.check(queue.drain(std::back_inserter(out), 100) == 3);
+                bool in_order = out.size() == 10;
+                for (size_t i = 0; i < out.size(); ++i) {
+                    in_order &= *out[i] == int(i < 7 ? i : i + 1);
+                }
+                test.check(in_order);
+                // empty and open, asking for nothing doesn't wait
+                test.check(queue.drain(std::back_inserter(out), 0) == 0);
+
+                BlockingDeque<std::string> strings(1);
+                const std::string word = "word";
+                test.check(strings.push_for(word, 1ms) && !strings.push_for(word, 1ms));
+                std::string popped;
+                test.check(strings.pop(popped) && popped == word && word == "word");
+
+                test.check(queue.push(std::make_unique<int>(11)));
+                queue.close();
+                test.check(!queue.push(std::make_unique<int>(12)));
+                test.check(queue.pop(value) && *value == 11);
+                test.check(!queue.pop(value) && queue.drain(std::back_inserter(out), 5) == 0);
+
+                int caught = 0;
+                try {
+                    BlockingDeque<int> empty(0);
+                } catch (std::invalid_argument&) {
+                    ++caught;
+                }
+                test.check(caught == 1);
+            }),
+            make_pretty_test("producers and consumers", [](auto& test){
+                const int producers = 4;
+                const int consumers = 3;
+                const int per_producer = 100'000;
+                BlockingDeque<int, 16> queue(64);
+                std::vector<std::thread> threads;
+                for (int p = 0; p < producers; ++p) {
+                    threads.emplace_back([&queue, p] {
+                        std::vector<int> batch;
+                        for (int i = 0; i < per_producer; ++i) {
+                            int value = p * per_producer + i;
+                            if (p % 2 == 0) {
+                                queue.push(value);
+                                continue;
+                            }
+                            batch.push_back(value);
+                            if (batch.size() == 50 || i + 1 == per_producer) {
+                                queue.push_batch(batch.begin(), batch.end());
+                                batch.clear();
+                            }
+                        }
+                    });
+                }
+                std::vector<std::vector<int>> received(consumers);
+                std::vector<std::thread> readers;
+                for (int c = 0; c < consumers; ++c) {
+                    readers.emplace_back([&queue, &received, c] {
+                        int value = 0;
+                        if (c == 0) {
+                            while (queue.pop(value)) {
+                                received[c].push_back(value);
+                            }
+                        } else {
+                            while (queue.drain(std::back_inserter(received[c]), 32) != 0) {
+                            }
+                        }
+                    });
+                }
+                for (auto& thread : threads) {
+                    thread.join();
+                }
+                queue.close();
+                for (auto& thread : readers) {
+                    thread.join();
+                }
+
+                // every value arrives once, each producer's in order
+                std::vector<int> all;
+                bool in_order = true;
+                for (const auto& part : received) {
+                    std::vector<int> last(producers, -1);
+                    for (int value : part) {
+                        in_order &= value > last[value / per_producer];
+                        last[value / per_producer] = value;
+                    }
+                    all.insert(all.end(), part.begin(), part.end());
+                }
+                std::sort(all.begin(), all.end());
+                std::vector<int> expected(producers * per_producer);
+                std::iota(expected.begin(), expected.end(), 0);
+                test.check(in_order && all == expected && queue.size() == 0);
+            })
+        };
+    }
+
+    TestGroup create_byte_deque_tests() {
+        return { "ByteDeque",
+            make_pretty_test("stream", [](auto& test){
+                ByteDeque<> buffer;
+                std::string expected;
+                for (int i = 0; i < 3000; ++i) {
+                    std::string line = "line " + std::to_string(i) + std::string(i % 50, 'x') + "\n";
+                    buffer.write(line.data(), line.size());
+                    expected += line;
+                }
+                test.check(buffer.size() == expected.size() && buffer.bytes().segments().size() > 10);
+
+                // every line is found across bucket edges and read whole
+                bool same = true;
+                int lines = 0;
+                for (size_t end; (end = buffer.find('\n')) != ByteDeque<>::npos; ++lines) {
+                    std::string line(end + 1, 0);
+                    test.check(buffer.peek(line.data(), 5) == 5);
+                    same &= line.compare(0, 5, "line ") == 0;
+                    same &= buffer.read(line.data(), line.size()) == line.size();
+                    same &= expected.compare(0, line.size(), line) == 0;
+                    expected.erase(0, line.size());
+                }
+                test.check(same && lines == 3000 && buffer.empty() && expected.empty());
+
+                buffer.write(std::span<const char>("abc,def,", 8));
+                test.check(buffer.find(',') == 3 && buffer.find(',', 4) == 7 && buffer.find(',', 8) == ByteDeque<>::npos);
+                test.check(buffer.find('z') == ByteDeque<>::npos && buffer[4] == 'd');
+                buffer.consume(4);
+                char out[16] = {};
+                test.check(buffer.read(out, sizeof(out)) == 4 && std::string(out) == "def,");
+                test.check(buffer.read(out, sizeof(out)) == 0);
+            }),
+            make_pretty_test("write to a pipe", [](auto& test){
+                ByteDeque<> buffer;
+                std::string payload(100'000, 0);
+                for (size_t i = 0; i < payload.size(); ++i) {
+                    payload[i] = char('a' + i % 26);
+                }
+                buffer.write(payload.data(), payload.size());
+                int fds[2];
+                test.check(pipe(fds) == 0);
+                // the pipe holds less than the buffer, writes have to be partial
+                test.check(fcntl(fds[1], F_SETFL, O_NONBLOCK) == 0);
+                std::string received;
+                while (!buffer.empty()) {
+                    test.check(WriteDeque(fds[1], buffer.bytes()) > 0);
+                    char chunk[65536];
+                    ssize_t part = read(fds[0], chunk, sizeof(chunk));
+                    received.append(chunk, part > 0 ? size_t(part) : 0);
+                }
+                close(fds[0]);
+                close(fds[1]);
+                test.check(received == payload);
+            })
+        };
+    }
+
+    TestGroup create_work_stealing_tests() {
+        return { "work stealing",
+            make_pretty_test("one thread", [](auto& test){
+                WorkStealingDeque<int> d(2);
+                int value = 0;
+                test.check(d.empty() && !d.try_pop_back(value) && !d.try_steal_front(value));
+                for (int i = 0; i < 100; ++i) {
+                    d.push_back(i);
+                }
+                test.check(d.size() == 100);
+                test.check(d.try_steal_front(value) && value == 0);
+                test.check(d.try_pop_back(value) && value == 99);
+                bool in_order = true;
+                for (int i = 98; i > 0; --i) {
+                    in_order &= d.try_pop_back(value) && value == i;
+                }
+                test.check(in_order && d.empty() && !d.try_pop_back(value));
+            }),
+            make_pretty_test("thieves", [](auto& test){
+                const int count = 200'000;
+                WorkStealingDeque<int> d;
+                std::vector<std::atomic<int>> taken(count);
+                std::atomic<bool> done = false;
+                std::vector<std::thread> thieves;
+                for (int i = 0; i < 3; ++i) {
+                    thieves.emplace_back([&] {
+                        int value = 0;
+                        while (!done.load() || !d.empty()) {
+                            if (d.try_steal_front(value)) {
+                                taken[value].fetch_add(1);
+                            }
+                        }
+                    });
+                }
+                int value = 0;
+                // a pop that loses the last element to a thief leaves value alone
+                bool kept = true;
+                for (int i = 0; i < count; ++i) {
+                    d.push_back(i);
+                    if (i % 3 == 0) {
+                        value = -1;
+                        if (d.try_pop_back(value)) {
+                            taken[value].fetch_add(1);
+                        } else {
+                            kept &= value == -1;
+                        }
+                    }
+                }
+                while (d.try_pop_back(value)) {
+                    taken[value].fetch_add(1);
+                }
+                done = true;
+                for (auto& thief : thieves) {
+                    thief.join();
+                }
+                test.check(kept);
+                test.check(std::all_of(taken.begin(), taken.end(), [](auto& times) { return times.load() == 1; }));
+            }),
+            make_pretty_test("thread pool", [](auto& test){
+                ThreadPool pool(4);
+                test.check(pool.size() == 4);
+                std::atomic<long> sum = 0;
+                // every task fans out into smaller ones from inside the pool
+                std::function<void(int, int)> split = [&](int from, int to) {
+                    if (to - from <= 100) {
+                        long part = 0;
+                        for (int i = from; i < to; ++i) {
+                            part += i;
+                        }
+                        sum += part;
+                        return;
+                    }
+                    int middle = from + (to - from) / 2;
+                    pool.submit([&split, from, middle] { split(from, middle); });
+                    pool.submit([&split, middle, to] { split(middle, to); });
+                };
+                pool.submit([&split] { split(0, 100'000); });
+                pool.wait();
+                test.check(sum.load() == 100'000L * 99'999 / 2);
+
+                for (int i = 0; i < 1000; ++i) {
+                    pool.submit([&sum] { --sum; });
+                }
+                pool.wait();
+                test.check(sum.load() == 100'000L * 99'999 / 2 - 1000);
+
+                pool.submit([] { throw std::runtime_error("task failed"); });
+                int caught = 0;
+                try {
+                    pool.wait();
+                } catch (std::runtime_error&) {
+                    ++caught;
+                }
+                pool.wait();
+                test.check(caught == 1);
+            })
+        };
+    }
+
     bool RunAll() {
         groups_t groups {};
         groups.push_back(create_constructor_tests());
         groups.push_back(create_access_tests());
         groups.push_back(create_iterator_tests());
         groups.push_back(create_modification_tests());
+        groups.push_back(create_small_deque_tests());
+        groups.push_back(create_cow_tests());
+        groups.push_back(create_mapped_tests());
+        groups.push_back(create_spsc_tests());
+        groups.push_back(create_blocking_tests());
+        groups.push_back(create_byte_deque_tests());
+        groups.push_back(create_work_stealing_tests());
 
         bool res = true;
         for (auto& g : groups) {
@@ -0,0 +1,199 @@
+#pragma once
+#include "deque.h"
+#include "work_stealing_deque.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Fixed number of workers, each with its own WorkStealingDeque of tasks.
+// A task submitted from a worker goes to the back of that worker's deque
+// and is run from there, newest first. Tasks submitted from other threads
+// wait in a shared Deque under a mutex. A worker with nothing to do takes
+// from the shared Deque, then steals from the front of the others, and
+// goes to sleep when no task is queued anywhere.
+class ThreadPool {
+ public:
+  explicit ThreadPool(size_t threads = std::thread::hardware_concurrency());
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+  // runs the queued tasks, then stops the workers
+  ~ThreadPool();
+
+  // if it throws, the task is not queued
+  void submit(std::function<void()> task);
+
+  // Blocks until every submitted task has run, tasks submitted meanwhile
+  // included. Rethrows the first exception a task threw. Must not be
+  // called from a task.
+  void wait();
+
+  size_t size() const;
+
+ private:
+  using Task = std::function<void()>;
+
+  struct Worker {
+    WorkStealingDeque<Task*> tasks;
+    std::thread thread;
+  };
+
+  void Run(size_t index);
+  bool FindTask(size_t index, Task*& task);
+  void Finish(Task* task);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  Deque<Task*> submitted_;            // from outside the pool, under mutex_
+  std::exception_ptr error_;          // under mutex_
+  bool stop_ = false;                 // under mutex_
+
+  std::atomic<size_t> queued_{0};     // submitted, not taken by a worker
+  std::atomic<size_t> outside_{0};    // size of submitted_, read unlocked
+  std::atomic<size_t> pending_{0};    // submitted, not finished
+  std::atomic<size_t> sleeping_{0};
+
+  // worker the current thread is, if it is one of ours
+  inline static thread_local ThreadPool* current_pool_ = nullptr;
+  inline static thread_local size_t current_index_ = 0;
+};
+
+inline ThreadPool::ThreadPool(size_t threads) {
+  if (threads == 0) {
+    threads = 1;
+  }
+  for (size_t i = 0; i < threads; ++i) {
+    workers_.push_back(std::make_unique<Worker>());
+  }
+  for (size_t i = 0; i < threads; ++i) {
+    workers_[i]->thread = std::thread([this, i] { Run(i); });
+  }
+}
+
+inline ThreadPool::~ThreadPool() {
+  {
+    std::unique_lock lock(mutex_);
+    done_.wait(lock, [this] { return pending_.load() == 0; });
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for (auto& worker : workers_) {
+    worker->thread.join();
+  }
+}
+
+inline size_t ThreadPool::size() const {
+  return workers_.size();
+}
+
+inline void ThreadPool::submit(std::function<void()> task) {
+  auto owned = std::make_unique<Task>(std::move(task));
+  pending_.fetch_add(1);
+  // counted before it can be taken, a worker going to sleep checks
+  // queued_ after announcing itself in sleeping_
+  queued_.fetch_add(1);
+  try {
+    if (current_pool_ == this) {
+      workers_[current_index_]->tasks.push_back(owned.get());
+    } else {
+      std::lock_guard lock(mutex_);
+      submitted_.push_back(owned.get());
+      outside_.fetch_add(1);
+    }
+  } catch (...) {
+    // not queued, nobody will run or finish it
+    queued_.fetch_sub(1);
+    if (pending_.fetch_sub(1) == 1) {
+      std::lock_guard lock(mutex_);
+      done_.notify_all();
+    }
+    throw;
+  }
+  owned.release();
+  if (sleeping_.load() > 0) {
+    std::lock_guard lock(mutex_);
+    wake_.notify_one();
+  }
+}
+
+inline void ThreadPool::wait() {
+  std::unique_lock lock(mutex_);
+  done_.wait(lock, [this] { return pending_.load() == 0; });
+  if (error_) {
+    std::rethrow_exception(std::exchange(error_, nullptr));
+  }
+}
+
+inline bool ThreadPool::FindTask(size_t index, Task*& task) {
+  if (workers_[index]->tasks.try_pop_back(task)) {
+    return true;
+  }
+  if (outside_.load() > 0) {
+    std::lock_guard lock(mutex_);
+    if (submitted_.size() != 0) {
+      task = submitted_.front();
+      submitted_.pop_front();
+      outside_.fetch_sub(1);
+      return true;
+    }
+  }
+  for (size_t i = 1; i < workers_.size(); ++i) {
+    size_t victim = (index + i) % workers_.size();
+    if (workers_[victim]->tasks.try_steal_front(task)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+inline void ThreadPool::Finish(Task* task) {
+  try {
+    (*task)();
+  } catch (...) {
+    std::lock_guard lock(mutex_);
+    if (!error_) {
+      error_ = std::current_exception();
+    }
+  }
+  delete task;
+  if (pending_.fetch_sub(1) == 1) {
+    std::lock_guard lock(mutex_);
+    done_.notify_all();
+  }
+}
+
+inline void ThreadPool::Run(size_t index) {
+  current_pool_ = this;
+  current_index_ = index;
+  while (true) {
+    Task* task = nullptr;
+    if (FindTask(index, task)) {
+      queued_.fetch_sub(1);
+      Finish(task);
+      continue;
+    }
+    if (queued_.load() > 0) {
+      // counted but not visible yet, or about to be taken by another
+      // worker; the wait below would return at once
+      std::this_thread::yield();
+      continue;
+    }
+    std::unique_lock lock(mutex_);
+    sleeping_.fetch_add(1);
+    wake_.wait(lock, [this] { return queued_.load() > 0 || stop_; });
+    sleeping_.fetch_sub(1);
+    if (stop_ && queued_.load() == 0) {
+      return;
+    }
+  }
+}
@@ -0,0 +1,161 @@
+#pragma once
+#include "deque.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// Chase-Lev work-stealing deque (with the memory orders of Le et al.,
+// "Correct and Efficient Work-Stealing for Weak Memory Models").
+// One owner thread pushes and pops at the back, any thread may steal from
+// the front. Values live in a circular array that is replaced by one
+// twice as big when it fills, the new array is published atomically and
+// the old ones are kept until the deque dies since thieves may still read
+// them. Values are copied with plain atomic loads and stores, so T has to
+// be trivially copyable, pointers to tasks for example.
+template<typename T>
+class WorkStealingDeque {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "values are read racily, has to be trivially copyable");
+
+ public:
+  explicit WorkStealingDeque(size_t capacity = kDefaultCapacity);
+  WorkStealingDeque(const WorkStealingDeque&) = delete;
+  WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+  // owner only
+  void push_back(T value);
+  bool try_pop_back(T& value);
+
+  // any thread, false if empty or another thief won the race
+  bool try_steal_front(T& value);
+
+  // only a snapshot when other threads are working on the deque
+  size_t size() const;
+  bool empty() const;
+
+ private:
+  static constexpr size_t kDefaultCapacity = 256;
+
+  struct Array {
+    explicit Array(size_t capacity)
+      : mask(capacity - 1)
+      , values(new std::atomic<T>[capacity])
+    {}
+
+    T Get(int64_t index) const {
+      return values[index & mask].load(std::memory_order_relaxed);
+    }
+    void Put(int64_t index, T value) {
+      values[index & mask].store(value, std::memory_order_relaxed);
+    }
+
+    int64_t mask;
+    std::unique_ptr<std::atomic<T>[]> values;
+  };
+
+  Array* Grow(Array* array, int64_t top, int64_t bottom);
+
+  alignas(kCacheLineSize) std::atomic<int64_t> top_;
+  alignas(kCacheLineSize) std::atomic<int64_t> bottom_;
+  std::atomic<Array*> array_;
+  std::vector<std::unique_ptr<Array>> arrays_;    // owner only
+};
+
+template<typename T>
+WorkStealingDeque<T>::WorkStealingDeque(size_t capacity):
+  top_(0),
+  bottom_(0)
+{
+  size_t rounded = 1;
+  while (rounded < capacity) {
+    rounded *= 2;
+  }
+  arrays_.push_back(std::make_unique<Array>(rounded));
+  array_.store(arrays_.back().get(), std::memory_order_relaxed);
+}
+
+template<typename T>
+typename WorkStealingDeque<T>::Array*
+WorkStealingDeque<T>::Grow(Array* array, int64_t top, int64_t bottom) {
+  arrays_.push_back(std::make_unique<Array>(2 * (array->mask + 1)));
+  Array* grown = arrays_.back().get();
+  for (int64_t i = top; i < bottom; ++i) {
+    grown->Put(i, array->Get(i));
+  }
+  array_.store(grown, std::memory_order_release);
+  return grown;
+}
+
+template<typename T>
+void WorkStealingDeque<T>::push_back(T value) {
+  int64_t bottom = bottom_.load(std::memory_order_relaxed);
+  int64_t top = top_.load(std::memory_order_acquire);
+  Array* array = array_.load(std::memory_order_relaxed);
+  if (bottom - top > array->mask) {
+    array = Grow(array, top, bottom);
+  }
+  array->Put(bottom, value);
+  std::atomic_thread_fence(std::memory_order_release);
+  bottom_.store(bottom + 1, std::memory_order_relaxed);
+}
+
+template<typename T>
+bool WorkStealingDeque<T>::try_pop_back(T& value) {
+  int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+  Array* array = array_.load(std::memory_order_relaxed);
+  bottom_.store(bottom, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t top = top_.load(std::memory_order_relaxed);
+
+  if (top > bottom) {
+    bottom_.store(bottom + 1, std::memory_order_relaxed);
+    return false;
+  }
+  T popped = array->Get(bottom);
+  if (top == bottom) {
+    // the last value, thieves may want it too
+    bool won = top_.compare_exchange_strong(top, top + 1,
+                                            std::memory_order_seq_cst,
+                                            std::memory_order_relaxed);
+    bottom_.store(bottom + 1, std::memory_order_relaxed);
+    if (!won) {
+      return false;
+    }
+  }
+  value = popped;
+  return true;
+}
+
+template<typename T>
+bool WorkStealingDeque<T>::try_steal_front(T& value) {
+  int64_t top = top_.load(std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t bottom = bottom_.load(std::memory_order_acquire);
+  if (top >= bottom) {
+    return false;
+  }
+  Array* array = array_.load(std::memory_order_acquire);
+  T stolen = array->Get(top);
+  if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                    std::memory_order_relaxed)) {
+    return false;
+  }
+  value = stolen;
+  return true;
+}
+
+template<typename T>
+size_t WorkStealingDeque<T>::size() const {
+  int64_t top = top_.load(std::memory_order_acquire);
+  int64_t bottom = bottom_.load(std::memory_order_acquire);
+  return bottom > top ? static_cast<size_t>(bottom - top) : 0;
+}
+
+template<typename T>
+bool WorkStealingDeque<T>::empty() const {
+  return size() == 0;
+}